@@ -0,0 +1,274 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include "Timer.h"
+#include "MappedFile.h"
+#include "RollingHash.h"
+#include "hash_verify.h"
+#include "sample_filter.h"
+#include "WorkStealingPool.h"
+#include "BatchDetector.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+using namespace std;
+
+// A file being scanned, shared by its tasks. The last task to finish with it
+//  deletes it, which unmaps the file
+struct FileScan {
+    const BatchJob *job;
+    BatchFileResult *out;
+    MappedFile *file;
+    const byte *data;
+    size_t len;
+    double start;
+
+    // For a file fingerprinted in pieces. Piece i is data[piece_starts[i]..piece_starts[i+1])
+    vector<int> numcopies_candidates;
+    vector<int> candidates;
+    size_t num_blocks;
+    size_t block_size;
+    vector<size_t> piece_starts;
+    // (offset, fingerprint of data[piece start..offset)) at each block
+    //  boundary in the piece and at its end
+    vector<vector<pair<size_t, fingerprint_t> > > piece_hashes;
+    atomic<size_t> pieces_left;
+
+    FileScan(): job(0), out(0), file(0), data(0), len(0), start(0.0), num_blocks(0), block_size(0), pieces_left(0) {}
+    ~FileScan() { delete file; }
+};
+
+static void hash_piece(FileScan *scan, size_t piece) {
+    size_t start = scan->piece_starts[piece];
+    size_t end = scan->piece_starts[piece + 1];
+    vector<pair<size_t, fingerprint_t> > &hashes = scan->piece_hashes[piece];
+    RollingHash hash;
+    size_t pos = start;
+    for (size_t b = (start / scan->block_size + 1) * scan->block_size; b <= end; b += scan->block_size) {
+        hash.update(scan->data + pos, b - pos);
+        hashes.push_back(make_pair(b, hash.get()));
+        pos = b;
+    }
+    if (pos < end) {
+        hash.update(scan->data + pos, end - pos);
+        hashes.push_back(make_pair(end, hash.get()));
+    }
+}
+
+// Combine the piece fingerprints into the prefix fingerprints at the block
+//  boundaries and check the candidates, as hash_find_num_copies() does
+static void finish_pieces(FileScan *scan, bool confirm, const Timer &timer) {
+    vector<fingerprint_t> prefixes(scan->num_blocks + 1);
+    prefixes[0] = RollingHash().get();
+    map<size_t, fingerprint_t> powers;
+    fingerprint_t piece_start_hash = prefixes[0];
+    for (size_t i = 0; i < scan->piece_hashes.size(); i++) {
+        size_t start = scan->piece_starts[i];
+        const vector<pair<size_t, fingerprint_t> > &hashes = scan->piece_hashes[i];
+        fingerprint_t h = piece_start_hash;
+        for (size_t j = 0; j < hashes.size(); j++) {
+            size_t n = hashes[j].first - start;
+            map<size_t, fingerprint_t>::iterator it = powers.find(n);
+            if (it == powers.end()) {
+                it = powers.insert(make_pair(n, RollingHash::power(n))).first;
+            }
+            h = RollingHash::concat(piece_start_hash, hashes[j].second, it->second);
+            if (hashes[j].first % scan->block_size == 0) {
+                prefixes[hashes[j].first / scan->block_size] = h;
+            }
+        }
+        piece_start_hash = h;
+    }
+
+    DetectorResult &result = scan->out->result;
+    result.stats.input_bytes = scan->len;
+    result.stats.bytes_read += scan->len;
+    int num_copies = hash_check_copies(scan->data, scan->len, scan->candidates, prefixes, confirm, &result.stats);
+    Detector::set_copies(scan->numcopies_candidates, num_copies, scan->len, &result);
+    scan->out->latency = timer.get() - scan->start;
+    result.duration = scan->out->latency;
+}
+
+double BatchResult::get_latency(double q) const {
+    if (files.empty()) {
+        return 0.0;
+    }
+    vector<double> latencies;
+    for (unsigned int i = 0; i < files.size(); i++) {
+        latencies.push_back(files[i].latency);
+    }
+    sort(latencies.begin(), latencies.end());
+    // Nearest rank
+    size_t rank = (size_t)(q * latencies.size() + 0.999999);
+    rank = min(max(rank, (size_t)1), latencies.size());
+    return latencies[rank - 1];
+}
+
+BatchResult BatchDetector::run(const vector<BatchJob> &jobs) const {
+    Timer timer;
+    BatchResult batch;
+    batch.files.resize(jobs.size());
+    WorkStealingPool pool(_num_threads);
+    const DetectorConfig config = _config;
+    const size_t split_size = max(_split_size, (size_t)1);
+    // With an index the job is not split, so that Detector fingerprints its
+    //  chunks in the pass that hashes it
+    bool split = (config.engine == ENGINE_ROLLING_HASH || config.engine == ENGINE_SINGLE_PASS) &&
+                 !config.fingerprints;
+    bool confirm = config.engine == ENGINE_ROLLING_HASH;
+
+    for (size_t i = 0; i < jobs.size(); i++) {
+        FileScan *scan = new FileScan();
+        scan->job = &jobs[i];
+        scan->out = &batch.files[i];
+        scan->out->path = jobs[i].path;
+
+        // Each file is a job of its own in the fingerprint index
+        DetectorConfig file_config = config;
+        file_config.job_id = config.job_id + (unsigned int)i;
+
+        pool.submit([scan, &pool, &timer, file_config, split, confirm, split_size]() {
+            scan->start = timer.get();
+            const BatchJob &job = *scan->job;
+            if (job.data) {
+                scan->data = job.data;
+                scan->len = job.len;
+            } else {
+                scan->file = new MappedFile(job.path.c_str());
+                scan->data = scan->file->get_data();
+                scan->len = scan->file->get_len();
+            }
+            scan->out->len = scan->len;
+            scan->out->ok = job.data || scan->file->is_open();
+
+            if (scan->out->ok && split && scan->len > split_size) {
+                scan->numcopies_candidates = get_factors(job.num_pages);
+                // As Detector does, so the pieces are not hashed at all if
+                //  sampling rules out every candidate
+                vector<int> sampled = scan->numcopies_candidates;
+                if (file_config.sample_budget > 0 && file_config.header_size == 0) {
+                    sample_filter_candidates(scan->data, scan->len, &sampled, file_config.sample_budget,
+                                             &scan->out->result.stats);
+                }
+                scan->num_blocks = hash_num_blocks(scan->len, sampled, &scan->candidates);
+            }
+            if (scan->num_blocks == 0) {
+                if (scan->out->ok) {
+                    scan->out->result = Detector(file_config).detect(scan->data, scan->len, job.num_pages);
+                }
+                scan->out->latency = timer.get() - scan->start;
+                delete scan;
+                return;
+            }
+
+            // Pieces of whole blocks if blocks are small, so the pieces
+            //  record the prefix fingerprints at only a few distinct offsets
+            scan->block_size = scan->len / scan->num_blocks;
+            size_t piece_len = scan->block_size <= split_size
+                ? (split_size / scan->block_size) * scan->block_size : split_size;
+            for (size_t ofs = 0; ofs < scan->len; ofs += piece_len) {
+                scan->piece_starts.push_back(ofs);
+            }
+            scan->piece_starts.push_back(scan->len);
+            size_t num_pieces = scan->piece_starts.size() - 1;
+            scan->piece_hashes.resize(num_pieces);
+            scan->pieces_left = num_pieces;
+            for (size_t p = 0; p < num_pieces; p++) {
+                pool.submit([scan, p, &timer, confirm]() {
+                    hash_piece(scan, p);
+                    if (--scan->pieces_left == 0) {
+                        finish_pieces(scan, confirm, timer);
+                        delete scan;
+                    }
+                });
+            }
+        });
+    }
+    pool.wait();
+
+    for (size_t i = 0; i < batch.files.size(); i++) {
+        batch.total_bytes += batch.files[i].len;
+    }
+    batch.duration = timer.get();
+    return batch;
+}
+
+#ifdef _WIN32
+
+bool list_spool_files(const char *dir, vector<string> *paths) {
+    paths->clear();
+    string pattern = string(dir) + "\\*";
+    WIN32_FIND_DATAA entry;
+    HANDLE find = FindFirstFileA(pattern.c_str(), &entry);
+    if (find == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    do {
+        if (!(entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+            paths->push_back(string(dir) + "\\" + entry.cFileName);
+        }
+    } while (FindNextFileA(find, &entry));
+    FindClose(find);
+    sort(paths->begin(), paths->end());
+    return true;
+}
+
+#else
+
+bool list_spool_files(const char *dir, vector<string> *paths) {
+    paths->clear();
+    DIR *d = opendir(dir);
+    if (!d) {
+        return false;
+    }
+    while (struct dirent *entry = readdir(d)) {
+        string path = string(dir) + "/" + entry->d_name;
+        struct stat st;
+        if (stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode)) {
+            paths->push_back(path);
+        }
+    }
+    closedir(d);
+    sort(paths->begin(), paths->end());
+    return true;
+}
+
+#endif
+
+bool read_job_list(const char *filename, vector<BatchJob> *jobs) {
+    FILE *f = fopen(filename, "rt");
+    if (!f) {
+        return false;
+    }
+    bool ok = true;
+    char line[4096];
+    while (fgets(line, sizeof(line), f)) {
+        size_t n = strlen(line);
+        while (n > 0 && (line[n - 1] == '\n' || line[n - 1] == '\r' || line[n - 1] == ' ')) {
+            line[--n] = 0;
+        }
+        if (n == 0 || line[0] == '#') {
+            continue;
+        }
+        // The page count is the last field so paths may contain spaces
+        char *space = strrchr(line, ' ');
+        int num_pages = space ? atoi(space + 1) : 0;
+        if (num_pages <= 0) {
+            ok = false;
+            break;
+        }
+        *space = 0;
+        jobs->push_back(BatchJob(line, num_pages));
+    }
+    fclose(f);
+    return ok;
+}
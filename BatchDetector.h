@@ -0,0 +1,80 @@
+#ifndef BATCH_DETECTOR_H
+#define BATCH_DETECTOR_H
+
+#include <string>
+#include <vector>
+#include "BinString.h"
+#include "Detector.h"
+
+// Files bigger than this are split into sub-tasks of about this size
+#define BATCH_SPLIT_SIZE (16*1024*1024)
+
+// A spool file to scan. If data is set it is scanned instead of the file at
+//  path, which is then only a name
+struct BatchJob {
+    std::string path;
+    int num_pages;
+    const byte *data;
+    size_t len;
+
+    BatchJob(const std::string &path = "", int num_pages = 0, const byte *data = 0, size_t len = 0):
+        path(path), num_pages(num_pages), data(data), len(len) {}
+};
+
+struct BatchFileResult {
+    std::string path;
+    size_t len;
+    bool ok;                    // false if the file could not be read
+    DetectorResult result;
+    double latency;             // seconds from starting the file to its result
+
+    BatchFileResult(): len(0), ok(false), latency(0.0) {}
+};
+
+struct BatchResult {
+    std::vector<BatchFileResult> files;     // in job order
+    size_t total_bytes;
+    double duration;                        // seconds for the whole batch
+
+    BatchResult(): total_bytes(0), duration(0.0) {}
+    double get_gb_per_sec() const { return duration > 0.0 ? total_bytes / duration / 1e9 : 0.0; }
+    // q'th quantile of the per-file latencies, e.g. 0.99
+    double get_latency(double q) const;
+};
+
+/*
+ * Runs a Detector on many spool files using a WorkStealingPool.
+ * Each file is a task. With the hash engines a file bigger than split_size is
+ *  fingerprinted in pieces by sub-tasks that idle workers steal, so one huge
+ *  file at the end of a batch does not leave the other cores idle. The
+ *  pieces are cut at the copy boundaries hash_find_num_copies() uses, and the
+ *  fingerprints are combined with RollingHash::concat(). The memcmp
+ *  confirmation of ENGINE_ROLLING_HASH and the other engines run as one task
+ *  per file, as do all files if config.fingerprints is set. File i is then
+ *  job config.job_id + i.
+ */
+class BatchDetector {
+    DetectorConfig _config;
+    int _num_threads;
+    size_t _split_size;
+
+public:
+    // num_threads <= 0 means one per core. config.num_threads should
+    //  normally be 1 as the pool already uses the cores. config.log is called
+    //  from all the pool threads
+    BatchDetector(const DetectorConfig &config = DetectorConfig(), int num_threads = 0,
+                  size_t split_size = BATCH_SPLIT_SIZE):
+        _config(config), _num_threads(num_threads), _split_size(split_size) {}
+
+    BatchResult run(const std::vector<BatchJob> &jobs) const;
+};
+
+// Regular files in directory dir, sorted by name. Returns false if dir is not
+//  a directory
+bool list_spool_files(const char *dir, std::vector<std::string> *paths);
+
+// Jobs from a text file with a "<path> <num pages>" line per spool file.
+//  Returns false if the file cannot be read or a line is bad
+bool read_job_list(const char *filename, std::vector<BatchJob> *jobs);
+
+#endif
@@ -0,0 +1,270 @@
+#include <stdlib.h>
+#include <iostream>
+#include <algorithm>
+#include "StreamDetector.h"
+#include "BlockReader.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <malloc.h>
+#else
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+using namespace std;
+
+static size_t round_up(size_t n, size_t align) {
+    return (n + align - 1) / align * align;
+}
+
+// All buffers are aligned for O_DIRECT, which costs nothing when it is not used
+static byte *alloc_buffer(size_t len) {
+#ifdef _WIN32
+    return (byte *)_aligned_malloc(len, READ_DIRECT_ALIGN);
+#else
+    void *buf;
+    return posix_memalign(&buf, READ_DIRECT_ALIGN, len) == 0 ? (byte *)buf : 0;
+#endif
+}
+
+static void free_buffer(byte *buf) {
+#ifdef _WIN32
+    _aligned_free(buf);
+#else
+    free(buf);
+#endif
+}
+
+#ifdef _WIN32
+
+bool BlockReader::_open(const char *path, bool direct) {
+    DWORD flags = FILE_ATTRIBUTE_NORMAL | (direct ? FILE_FLAG_NO_BUFFERING : FILE_FLAG_SEQUENTIAL_SCAN);
+    _file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, flags, NULL);
+    if (_file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(_file, &size)) {
+        _close();
+        return false;
+    }
+    _len = (size_t)size.QuadPart;
+    _direct = direct;
+    return true;
+}
+
+void BlockReader::_close() {
+    if (_file != INVALID_HANDLE_VALUE) {
+        CloseHandle(_file);
+        _file = INVALID_HANDLE_VALUE;
+    }
+}
+
+long long BlockReader::_read_at(byte *buf, size_t len, size_t offset) {
+    OVERLAPPED overlapped = {0};
+    overlapped.Offset = (DWORD)offset;
+    overlapped.OffsetHigh = (DWORD)((unsigned long long)offset >> 32);
+    DWORD num_read = 0;
+    if (!ReadFile(_file, buf, (DWORD)len, &num_read, &overlapped)) {
+        return GetLastError() == ERROR_HANDLE_EOF ? 0 : -1;
+    }
+    return num_read;
+}
+
+#else
+
+bool BlockReader::_open(const char *path, bool direct) {
+    int flags = O_RDONLY;
+    if (direct) {
+#ifdef O_DIRECT
+        flags |= O_DIRECT;
+#else
+        return false;
+#endif
+    }
+    _fd = open(path, flags);
+    if (_fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(_fd, &st) != 0) {
+        _close();
+        return false;
+    }
+    _len = (size_t)st.st_size;
+    _direct = direct;
+#ifdef POSIX_FADV_SEQUENTIAL
+    // Only a hint, as in MappedFile
+    if (!direct) {
+        posix_fadvise(_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+#endif
+    return true;
+}
+
+void BlockReader::_close() {
+    if (_fd >= 0) {
+        close(_fd);
+        _fd = -1;
+    }
+}
+
+long long BlockReader::_read_at(byte *buf, size_t len, size_t offset) {
+    ssize_t n;
+    do {
+        n = pread(_fd, buf, len, (off_t)offset);
+    } while (n < 0 && errno == EINTR);
+    return n;
+}
+
+#endif
+
+BlockReader::BlockReader(const char *path, const ReaderConfig &config):
+    _config(config),
+    _len(0),
+    _ok(false),
+    _direct(false),
+#ifdef _WIN32
+    _file(INVALID_HANDLE_VALUE),
+#else
+    _fd(-1),
+#endif
+    _num_full(0),
+    _next_buffer(0),
+    _holding(false),
+    _done(false),
+    _error(false),
+    _stop(false)
+{
+    _config.num_buffers = max(_config.num_buffers, 2);
+    _config.block_size = round_up(max(_config.block_size, (size_t)1), _config.direct ? READ_DIRECT_ALIGN : 1);
+    if (!(_config.direct && _open(path, true)) && !_open(path, false)) {
+        cerr << "BlockReader: cannot open " << path << endl;
+        return;
+    }
+
+    _buffers.resize(_config.num_buffers);
+    for (unsigned int i = 0; i < _buffers.size(); i++) {
+        _buffers[i].data = alloc_buffer(_config.block_size);
+        _buffers[i].len = 0;
+        if (!_buffers[i].data) {
+            cerr << "BlockReader: cannot allocate " << _config.num_buffers << " buffers of "
+                << _config.block_size << " bytes" << endl;
+            return;
+        }
+    }
+    _ok = true;
+    _thread = thread(&BlockReader::_read_blocks, this);
+}
+
+BlockReader::~BlockReader()
+{
+    {
+        lock_guard<mutex> lock(_lock);
+        _stop = true;
+    }
+    _changed.notify_all();
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+    for (unsigned int i = 0; i < _buffers.size(); i++) {
+        free_buffer(_buffers[i].data);
+    }
+    _close();
+}
+
+void BlockReader::_read_blocks() {
+    const size_t block_size = _config.block_size;
+    size_t buffer = 0;
+    for (size_t offset = 0; offset < _len; offset += block_size) {
+        {
+            unique_lock<mutex> lock(_lock);
+            _changed.wait(lock, [this]() { return _stop || _num_full < _buffers.size(); });
+            if (_stop) {
+                return;
+            }
+        }
+
+        // The buffer is not full so next() is not using it
+        byte *data = _buffers[buffer].data;
+        size_t len = min(block_size, _len - offset);
+        size_t num_read = 0;
+        while (num_read < len) {
+            // O_DIRECT reads whole aligned blocks even at the end of the file
+            size_t request = len - num_read;
+            if (_direct) {
+                request = round_up(request, READ_DIRECT_ALIGN);
+            }
+            long long n = _read_at(data + num_read, request, offset + num_read);
+            if (n <= 0) {
+                break;
+            }
+            num_read += (size_t)n;
+        }
+
+        lock_guard<mutex> lock(_lock);
+        if (num_read < len) {
+            _error = true;
+            _done = true;
+            _changed.notify_all();
+            return;
+        }
+        _buffers[buffer].len = len;
+        _num_full++;
+        _changed.notify_all();
+        buffer = (buffer + 1) % _buffers.size();
+    }
+
+    lock_guard<mutex> lock(_lock);
+    _done = true;
+    _changed.notify_all();
+}
+
+const byte *BlockReader::next(size_t *len) {
+    if (!_ok) {
+        return 0;
+    }
+    unique_lock<mutex> lock(_lock);
+    if (_holding) {
+        // The caller is finished with the last block
+        _holding = false;
+        _num_full--;
+        _next_buffer = (_next_buffer + 1) % _buffers.size();
+        _changed.notify_all();
+    }
+    _changed.wait(lock, [this]() { return _num_full > 0 || _done; });
+    if (_num_full == 0 || _error) {
+        return 0;
+    }
+    _holding = true;
+    *len = _buffers[_next_buffer].len;
+    return _buffers[_next_buffer].data;
+}
+
+bool BlockReader::has_error() {
+    lock_guard<mutex> lock(_lock);
+    return _error;
+}
+
+int stream_find_num_copies(const char *path, int num_pages, const ReaderConfig &config, ScanStats *stats) {
+    BlockReader reader(path, config);
+    if (!reader.is_open()) {
+        return -1;
+    }
+    StreamDetector detector(reader.get_len(), num_pages);
+    size_t len;
+    while (const byte *block = reader.next(&len)) {
+        detector.push(block, len);
+        if (detector.get_num_alive() == 0) {
+            break;
+        }
+    }
+    if (stats) {
+        *stats = detector.get_stats();
+        stats->input_bytes = reader.get_len();
+    }
+    return reader.has_error() ? -1 : detector.finish();
+}
@@ -0,0 +1,103 @@
+#ifndef BLOCK_READER_H
+#define BLOCK_READER_H
+
+#include <stddef.h>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "BinString.h"
+#include "inline_copies.h"
+
+// Defaults for ReaderConfig
+#define READ_BLOCK_SIZE (4*1024*1024)
+#define READ_NUM_BUFFERS 4
+
+// O_DIRECT buffers, offsets and lengths must be multiples of this
+#define READ_DIRECT_ALIGN 4096
+
+struct ReaderConfig {
+    size_t block_size;      // rounded up to READ_DIRECT_ALIGN if direct
+    int num_buffers;        // blocks read ahead, at least 2
+    bool direct;            // bypass the page cache with O_DIRECT
+
+    ReaderConfig(): block_size(READ_BLOCK_SIZE), num_buffers(READ_NUM_BUFFERS), direct(false) {}
+};
+
+/*
+ * Reads a file front to back in fixed size blocks on a thread of its own, so
+ *  reading the file and finding copies in it overlap instead of adding up.
+ * The reader thread fills a ring of num_buffers buffers and waits when they
+ *  are all full, so memory is num_buffers * block_size whatever the file
+ *  size. next() hands them out in file order.
+ *
+ *  BlockReader reader(path);
+ *  while (const byte *block = reader.next(&len)) ...
+ *
+ * In direct mode the blocks are read with O_DIRECT (FILE_FLAG_NO_BUFFERING on
+ *  Windows) so a huge spool does not push everything else out of the page
+ *  cache. If the file system does not support it the file is read normally
+ *  and is_direct() is false.
+ */
+class BlockReader
+{
+    struct Buffer {
+        byte *data;
+        size_t len;
+    };
+
+    ReaderConfig _config;
+    size_t _len;
+    bool _ok;
+    bool _direct;
+#ifdef _WIN32
+    void *_file;
+#else
+    int _fd;
+#endif
+
+    std::vector<Buffer> _buffers;
+    std::thread _thread;
+    std::mutex _lock;
+    std::condition_variable _changed;
+    size_t _num_full;           // buffers read and not yet released by next()
+    size_t _next_buffer;        // the buffer next() returns next
+    bool _holding;              // the caller has the buffer before _next_buffer
+    bool _done;                 // the reader thread has read its last block
+    bool _error;
+    bool _stop;                 // the destructor wants the reader thread to stop
+
+    // Not copyable. The file and the thread are owned by exactly one object.
+    BlockReader(const BlockReader &);
+    BlockReader &operator=(const BlockReader &);
+
+    bool _open(const char *path, bool direct);
+    void _close();
+    // Read up to len bytes at offset. Returns the number read or -1
+    long long _read_at(byte *buf, size_t len, size_t offset);
+    void _read_blocks();
+
+public:
+    BlockReader(const char *path, const ReaderConfig &config = ReaderConfig());
+    ~BlockReader();
+
+    bool is_open() const { return _ok; }
+    bool is_direct() const { return _direct; }
+    size_t get_len() const { return _len; }
+
+    // The next block of the file. It stays valid until the next call. Returns
+    //  NULL at the end of the file or if a read failed
+    const byte *next(size_t *len);
+
+    // true if a read failed
+    bool has_error();
+};
+
+// StreamDetector fed by a BlockReader, so the file is hashed while it is
+//  being read. Reading stops as soon as all the candidates are ruled out.
+//  Returns the number of copies or -1 if there are none or the file cannot
+//  be read
+int stream_find_num_copies(const char *path, int num_pages, const ReaderConfig &config = ReaderConfig(),
+                           ScanStats *stats = 0);
+
+#endif
@@ -0,0 +1,196 @@
+#include "Timer.h"
+#include "MappedFile.h"
+#include "hash_verify.h"
+#include "sampled_anchor.h"
+#include "period.h"
+#include "FingerprintIndex.h"
+#include "Detector.h"
+
+using namespace std;
+
+DetectorResult Detector::detect(const byte *data, size_t len, int num_pages) const {
+    DetectorWorkspace workspace;
+    DetectorResult result;
+    detect(data, len, num_pages, &workspace, &result);
+    return result;
+}
+
+void Detector::detect(const byte *data, size_t len, int num_pages, DetectorWorkspace *workspace,
+                      DetectorResult *result) const {
+    Timer timer;
+    const CopyLog &log = _config.log;
+
+    vector<int> &numcopies_candidates = workspace->numcopies_candidates;
+    get_factors(num_pages, &numcopies_candidates);
+    if (log.enabled()) {
+        log.log("num_pages = %d, %d candidates", num_pages, (int)numcopies_candidates.size());
+    }
+    result->offsets.clear();
+    result->stats = ScanStats();
+    result->stats.input_bytes = len;
+
+    int num_copies = -1;
+    CopyLayout page_layout = LAYOUT_NONE;
+    bool chunks_hashed = false;         // the hash engine fingerprinted the chunks
+    if (_config.engine == ENGINE_PAGE_INDEX) {
+        // The candidates are factors of the number of pages there really are
+        const PageFormat *format = index_pages(data, len, &workspace->pages);
+        result->stats.bytes_read += len;
+        int indexed_pages = (int)workspace->pages.get_num_pages();
+        if (log.enabled()) {
+            log.log("%s: %d pages", format->name, indexed_pages);
+        }
+        if (log.enabled() && num_pages > 0 && indexed_pages != num_pages) {
+            log.log("%d pages expected", num_pages);
+        }
+        get_factors(indexed_pages, &numcopies_candidates);
+        num_copies = page_find_num_copies(data, len, workspace->pages, numcopies_candidates, _config.confirm_pages,
+                                          &workspace->page_hashes, &result->offsets, &page_layout,
+                                          &result->stats);
+    } else if (numcopies_candidates.empty() || len == 0) {
+        // Nothing to test
+    } else if (_config.engine == ENGINE_BOYER_MOORE) {
+        const vector<int> &candidates = sample_candidates(data, len, workspace, &result->stats);
+        if (!candidates.empty()) {
+            num_copies = find_num_copies(data, len, num_pages, candidates, _config.header_size,
+                                         _config.num_threads, log, &workspace->search, &result->offsets,
+                                         &result->stats);
+        }
+    } else if (_config.engine == ENGINE_PERIOD) {
+        // One search answers all the candidates, so there is nothing to sample
+        num_copies = period_find_num_copies(data, len, numcopies_candidates, &result->stats);
+    } else if (_config.engine == ENGINE_RUN_LENGTH) {
+        // Every candidate passes the sample filter on blank input, so do not
+        //  sample. The runs are encoded once for all the candidates
+        num_copies = run_length_find_num_copies(data, len, numcopies_candidates, &workspace->runs,
+                                                &result->stats);
+    } else if (_config.engine == ENGINE_SAMPLED_ANCHOR) {
+        // anchor_find_num_copies() without throwing away the offsets
+        for (unsigned int i = 0; i < numcopies_candidates.size() && num_copies < 0; i++) {
+            size_t repeat_len;
+            vector<size_t> offsets = find_repeats_sampled(data, len, numcopies_candidates[i], _config.tolerance,
+                                                          &repeat_len, &result->stats);
+            if ((int)offsets.size() == numcopies_candidates[i]) {
+                num_copies = numcopies_candidates[i];
+                result->offsets = offsets;
+            }
+        }
+    } else {
+        // hash_find_num_copies() in the workspace
+        const vector<int> &candidates = sample_candidates(data, len, workspace, &result->stats);
+        size_t num_blocks = hash_num_blocks(len, candidates, &workspace->candidates);
+        if (num_blocks > 0 && _config.fingerprints) {
+            // The chunks for the fingerprint index in the same pass
+            chunk_pages(len, _config.fingerprint_chunk_size, &workspace->pages);
+            prefix_fingerprints(data, len, num_blocks, &workspace->prefixes, workspace->pages,
+                                &workspace->page_hashes);
+            chunks_hashed = true;
+        } else if (num_blocks > 0) {
+            prefix_fingerprints(data, len, num_blocks, &workspace->prefixes);
+        }
+        if (num_blocks > 0) {
+            result->stats.bytes_read += len;
+            num_copies = hash_check_copies(data, len, workspace->candidates, workspace->prefixes,
+                                           _config.engine == ENGINE_ROLLING_HASH, &result->stats);
+        }
+    }
+
+    result->known_pages = 0;
+    result->reprint_of = -1;
+    if (_config.fingerprints) {
+        if (_config.engine != ENGINE_PAGE_INDEX && !chunks_hashed) {
+            // An engine that does not hash the input
+            chunk_pages(len, _config.fingerprint_chunk_size, &workspace->pages);
+            page_fingerprints(data, len, workspace->pages, &workspace->page_hashes, &result->stats);
+        }
+        // Look up before adding so a job does not match itself
+        FingerprintIndex *fingerprints = _config.fingerprints;
+        result->known_pages = fingerprints->match_pages(workspace->pages, workspace->page_hashes,
+                                                        &result->reprint_of);
+        size_t num_added = fingerprints->add_pages(workspace->pages, workspace->page_hashes, _config.job_id);
+        if (log.enabled()) {
+            log.log("%d of %d pages known, reprint of job %d, %d pages added", (int)result->known_pages,
+                    (int)workspace->pages.get_num_pages(), result->reprint_of, (int)num_added);
+        }
+    }
+
+    set_copies(numcopies_candidates, num_copies, len, result);
+    if (num_copies > 1 && _config.engine == ENGINE_PAGE_INDEX) {
+        result->layout = page_layout;
+        const PageIndex &pages = workspace->pages;
+        size_t num_pages = pages.get_num_pages();
+        if (page_layout == LAYOUT_COLLATED) {
+            result->copy_size = result->offsets[1] - result->offsets[0];
+        } else {
+            // Copy 0 is pages 0, K, 2K...
+            result->copy_size = 0;
+            for (size_t i = 0; i < num_pages; i += num_copies) {
+                result->copy_size += pages.ends[i] - pages.starts[i];
+            }
+        }
+        // The last page of each copy, or the first page if uncollated
+        size_t step = page_layout == LAYOUT_COLLATED ? num_pages / num_copies : 1;
+        for (int i = 0; i < num_copies; i++) {
+            result->ends[i] = pages.ends[(i + 1) * step - 1];
+        }
+    }
+    result->duration = timer.get();
+    if (log.enabled()) {
+        log.log("Found %d%s copies, %d candidates rejected in %.6f sec", num_copies,
+                result->layout == LAYOUT_UNCOLLATED ? " uncollated" : "", (int)result->rejected.size(),
+                result->duration);
+    }
+}
+
+const vector<int> &Detector::sample_candidates(const byte *data, size_t len, DetectorWorkspace *workspace,
+                                               ScanStats *stats) const {
+    vector<int> &sampled = workspace->sampled;
+    sampled.assign(workspace->numcopies_candidates.begin(), workspace->numcopies_candidates.end());
+    if (_config.sample_budget > 0 && _config.header_size == 0) {
+        size_t num_removed = sample_filter_candidates(data, len, &sampled, _config.sample_budget, stats);
+        if (_config.log.enabled()) {
+            _config.log.log("Sampling removed %d of %d candidates", (int)num_removed,
+                            (int)workspace->numcopies_candidates.size());
+        }
+    }
+    return sampled;
+}
+
+void Detector::set_copies(const vector<int> &numcopies_candidates, int num_copies, size_t len,
+                          DetectorResult *result) {
+    // All the engines accept the largest candidate that matches
+    result->rejected.clear();
+    for (unsigned int i = 0; i < numcopies_candidates.size() && numcopies_candidates[i] != num_copies; i++) {
+        result->rejected.push_back(numcopies_candidates[i]);
+    }
+    result->num_copies = num_copies;
+    result->layout = num_copies > 0 ? LAYOUT_COLLATED : LAYOUT_NONE;
+    if (num_copies > 0) {
+        result->copy_size = len / num_copies;
+        // Exact copies are back to back
+        if (result->offsets.empty()) {
+            for (int i = 0; i < num_copies; i++) {
+                result->offsets.push_back(i * result->copy_size);
+            }
+        }
+        result->ends.clear();
+        for (int i = 0; i < num_copies; i++) {
+            result->ends.push_back(min(result->offsets[i] + result->copy_size, len));
+        }
+    } else {
+        result->copy_size = 0;
+        result->offsets.clear();
+        result->ends.clear();
+    }
+}
+
+DetectorResult Detector::detect_file(const char *path, int num_pages) const {
+    MappedFile input(path);
+    if (!input.is_open()) {
+        if (_config.log.enabled()) {
+            _config.log.log("Could not open %s", path);
+        }
+        return DetectorResult();
+    }
+    return detect(input.get_data(), input.get_len(), num_pages);
+}
@@ -0,0 +1,130 @@
+#ifndef DETECTOR_H
+#define DETECTOR_H
+
+#include <vector>
+#include "BinString.h"
+#include "RollingHash.h"
+#include "PageIndex.h"
+#include "sample_filter.h"
+#include "run_length.h"
+#include "inline_copies.h"
+
+class FingerprintIndex;
+
+// The engines other than ENGINE_PAGE_INDEX fingerprint the input for a
+//  FingerprintIndex in chunks of this many bytes, as they do not find pages
+#define FINGERPRINT_CHUNK_SIZE (64*1024)
+
+// How a Detector looks for copies
+struct DetectorConfig {
+    CopyEngine engine;
+    int num_threads;            // Boyer-Moore search threads, <= 0 for all cores
+    size_t header_size;         // per-copy header the Boyer-Moore search ignores
+    size_t tolerance;           // how far the sampled-anchor search lets copies move
+    CopyLog log;                // progress messages, none by default
+    size_t sample_budget;       // windows sample_filter_candidates() compares per candidate, 0 for none
+    FingerprintIndex *fingerprints; // if set, look up the pages of the input then add them
+    unsigned int job_id;        //  as pages of this job
+    size_t fingerprint_chunk_size;  // what counts as a page for the engines that do not find pages
+    bool confirm_pages;         // ENGINE_PAGE_INDEX also memcmp()s the pages of the copies it finds,
+                                //  which reads them again. Otherwise the page fingerprints decide
+
+    DetectorConfig():
+        engine(ENGINE_ROLLING_HASH),
+        num_threads(1),
+        header_size(0),
+        tolerance(0),
+        sample_budget(SAMPLE_BUDGET),
+        fingerprints(0),
+        job_id(0),
+        fingerprint_chunk_size(FINGERPRINT_CHUNK_SIZE),
+        confirm_pages(false)
+    {}
+};
+
+// What a Detector found
+struct DetectorResult {
+    int num_copies;                 // -1 if there are no copies
+    CopyLayout layout;              // only ENGINE_PAGE_INDEX finds uncollated copies
+    size_t copy_size;               // bytes in each copy, 0 if there are no copies. With
+                                    //  ENGINE_PAGE_INDEX the distance between collated copies,
+                                    //  or the bytes in the pages of one uncollated copy
+    std::vector<size_t> offsets;    // offset of each copy in the input, of its first page if uncollated
+    std::vector<size_t> ends;       // where each copy, or its first page, ends. Job control such as
+                                    //  PJL may come between the end of a copy and the next one
+    std::vector<int> rejected;      // candidate numbers of copies that did not match, largest first
+    ScanStats stats;
+    double duration;                // seconds
+    size_t known_pages;             // pages, or chunks, already in DetectorConfig::fingerprints
+    int reprint_of;                 // job that has every page of the input, -1 if none
+
+    DetectorResult(): num_copies(-1), layout(LAYOUT_NONE), copy_size(0), duration(0.0), known_pages(0), reprint_of(-1) {}
+};
+
+// Memory a Detector reuses from one detect() to the next. Once it has grown
+//  to fit the biggest input, detect() with a workspace allocates nothing
+struct DetectorWorkspace {
+    std::vector<int> numcopies_candidates;
+    std::vector<int> sampled;               // those that pass sample_filter_candidates()
+    std::vector<int> candidates;            // those the hash engines test
+    std::vector<fingerprint_t> prefixes;
+    SearchScratch search;
+    PageIndex pages;
+    std::vector<fingerprint_t> page_hashes;
+    std::vector<ByteRun> runs;
+};
+
+/*
+ * Finds inline copies in spool data. This is the library interface to
+ *  find_copies(): the settings are in a DetectorConfig rather than globals so
+ *  Detectors with different settings can run at the same time, and the
+ *  result says where the copies are.
+ * Nothing is written to the console. Progress goes to config.log.
+ * Before the Boyer-Moore and hash engines check a candidate in full,
+ *  sample_filter_candidates() drops most of the wrong ones after reading a
+ *  few KB. It is not used with a copy header, as the Boyer-Moore search then
+ *  lets copies move.
+ * With config.fingerprints the pages of every input are looked up in and
+ *  then added to a FingerprintIndex, so reprints of earlier jobs are
+ *  recognised. ENGINE_PAGE_INDEX fingerprints the pages anyway. The other
+ *  engines do not find pages, so they record config.fingerprint_chunk_size
+ *  byte chunks instead. The hash engines fingerprint the chunks in the pass
+ *  they already make. The others, which do not hash, take one more pass.
+ *  Chunks and pages do not match each other, so an index should be filled
+ *  by either ENGINE_PAGE_INDEX or the other engines.
+ */
+class Detector {
+    DetectorConfig _config;
+
+    // The candidates in workspace that pass sample_filter_candidates()
+    const std::vector<int> &sample_candidates(const byte *data, size_t len, DetectorWorkspace *workspace,
+                                              ScanStats *stats) const;
+
+public:
+    Detector(const DetectorConfig &config = DetectorConfig()): _config(config) {}
+    const DetectorConfig &get_config() const { return _config; }
+
+    // Copies in a num_pages document in data[0..len). ENGINE_PAGE_INDEX
+    //  counts the pages itself and num_pages may be 0
+    DetectorResult detect(const byte *data, size_t len, int num_pages) const;
+    DetectorResult detect(const BinString &input, int num_pages) const {
+        return detect(input.get_data(), input.get_len(), num_pages);
+    }
+
+    // detect() that reuses the memory of workspace and result. Once they have
+    //  grown no memory is allocated with the Boyer-Moore engine (with 1
+    //  thread) or the hash engines. The sampled-anchor engine still allocates
+    void detect(const byte *data, size_t len, int num_pages, DetectorWorkspace *workspace,
+                DetectorResult *result) const;
+
+    // Copies in a spool file, which is memory-mapped. Returns no copies if the
+    //  file cannot be read
+    DetectorResult detect_file(const char *path, int num_pages) const;
+
+    // Fill in result for num_copies collated copies (-1 for none) of len
+    //  bytes found by testing numcopies_candidates largest first
+    static void set_copies(const std::vector<int> &numcopies_candidates, int num_copies, size_t len,
+                           DetectorResult *result);
+};
+
+#endif
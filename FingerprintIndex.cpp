@@ -0,0 +1,326 @@
+#include <string.h>
+#include <iostream>
+#include "FingerprintIndex.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+static const char MAGIC[8] = {'I', 'C', 'F', 'P', 'I', 'D', 'X', '1'};
+
+struct FingerprintIndexHeader {
+    char magic[8];
+    unsigned long long capacity;    // a power of 2
+    unsigned long long count;
+    unsigned long long reserved[5];
+};
+
+// Empty slots have fingerprint 0, so a page whose fingerprint really is 0
+//  is stored as ~0. The page length tells the two apart
+static fingerprint_t get_key(fingerprint_t fingerprint) {
+    return fingerprint ? fingerprint : ~(fingerprint_t)0;
+}
+
+// Other processes may be writing the entry, see FingerprintIndex
+static fingerprint_t load_key(const FingerprintEntry *entry) {
+#ifdef __GNUC__
+    return __atomic_load_n(&entry->fingerprint, __ATOMIC_ACQUIRE);
+#else
+    return *(volatile const fingerprint_t *)&entry->fingerprint;
+#endif
+}
+
+static void store_key(FingerprintEntry *entry, fingerprint_t key) {
+#ifdef __GNUC__
+    __atomic_store_n(&entry->fingerprint, key, __ATOMIC_RELEASE);
+#else
+    *(volatile fingerprint_t *)&entry->fingerprint = key;
+#endif
+}
+
+static size_t get_map_len(size_t capacity) {
+    return sizeof(FingerprintIndexHeader) + capacity * sizeof(FingerprintEntry);
+}
+
+#ifdef _WIN32
+
+FingerprintIndex::FingerprintIndex(const char *path, size_t capacity):
+    _header(0),
+    _entries(0),
+    _map_len(0),
+    _ok(false),
+    _file(INVALID_HANDLE_VALUE),
+    _mapping(0)
+{
+    _file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                        OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (_file == INVALID_HANDLE_VALUE) {
+        cerr << "FingerprintIndex: cannot open " << path << endl;
+        return;
+    }
+
+    // Another process may be creating the file
+    lock();
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(_file, &size)) {
+        cerr << "FingerprintIndex: cannot get size of " << path << endl;
+        unlock();
+        return;
+    }
+    bool created = size.QuadPart == 0;
+    if (created) {
+        size_t slots = 16;
+        while (slots < capacity) {
+            slots *= 2;
+        }
+        _map_len = get_map_len(slots);
+    } else {
+        _map_len = (size_t)size.QuadPart;
+    }
+    if (_map_len < sizeof(FingerprintIndexHeader)) {
+        cerr << "FingerprintIndex: " << path << " is not an index" << endl;
+        unlock();
+        return;
+    }
+
+    // Mapping more than the file size extends the file with zeros
+    LARGE_INTEGER map_len;
+    map_len.QuadPart = _map_len;
+    _mapping = CreateFileMappingA(_file, NULL, PAGE_READWRITE, map_len.HighPart, map_len.LowPart, NULL);
+    if (!_mapping) {
+        cerr << "FingerprintIndex: cannot map " << path << endl;
+        unlock();
+        return;
+    }
+    _header = (FingerprintIndexHeader *)MapViewOfFile(_mapping, FILE_MAP_WRITE, 0, 0, 0);
+    if (!_header) {
+        cerr << "FingerprintIndex: cannot map view of " << path << endl;
+        unlock();
+        return;
+    }
+    if (created) {
+        _header->capacity = (_map_len - sizeof(FingerprintIndexHeader)) / sizeof(FingerprintEntry);
+        memcpy(_header->magic, MAGIC, sizeof(MAGIC));
+    }
+    unlock();
+
+    if (memcmp(_header->magic, MAGIC, sizeof(MAGIC)) != 0 || _map_len != get_map_len(_header->capacity)) {
+        cerr << "FingerprintIndex: " << path << " is not an index" << endl;
+        return;
+    }
+    _entries = (FingerprintEntry *)(_header + 1);
+    _ok = true;
+}
+
+FingerprintIndex::~FingerprintIndex()
+{
+    if (_header) {
+        UnmapViewOfFile(_header);
+    }
+    if (_mapping) {
+        CloseHandle(_mapping);
+    }
+    if (_file != INVALID_HANDLE_VALUE) {
+        CloseHandle(_file);
+    }
+}
+
+void FingerprintIndex::lock() {
+    _lock.lock();
+    OVERLAPPED overlapped = {0};
+    LockFileEx(_file, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &overlapped);
+}
+
+void FingerprintIndex::unlock() {
+    OVERLAPPED overlapped = {0};
+    UnlockFileEx(_file, 0, 1, 0, &overlapped);
+    _lock.unlock();
+}
+
+#else
+
+FingerprintIndex::FingerprintIndex(const char *path, size_t capacity):
+    _header(0),
+    _entries(0),
+    _map_len(0),
+    _ok(false),
+    _fd(-1)
+{
+    _fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (_fd < 0) {
+        cerr << "FingerprintIndex: cannot open " << path << endl;
+        return;
+    }
+
+    // Another process may be creating the file
+    lock();
+    struct stat st;
+    if (fstat(_fd, &st) != 0) {
+        cerr << "FingerprintIndex: cannot stat " << path << endl;
+        unlock();
+        return;
+    }
+    bool created = st.st_size == 0;
+    if (created) {
+        size_t slots = 16;
+        while (slots < capacity) {
+            slots *= 2;
+        }
+        _map_len = get_map_len(slots);
+        if (ftruncate(_fd, _map_len) != 0) {
+            cerr << "FingerprintIndex: cannot create " << path << endl;
+            unlock();
+            return;
+        }
+    } else {
+        _map_len = (size_t)st.st_size;
+    }
+    if (_map_len < sizeof(FingerprintIndexHeader)) {
+        cerr << "FingerprintIndex: " << path << " is not an index" << endl;
+        unlock();
+        return;
+    }
+
+    void *addr = mmap(NULL, _map_len, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+    if (addr == MAP_FAILED) {
+        cerr << "FingerprintIndex: cannot map " << path << endl;
+        _map_len = 0;
+        unlock();
+        return;
+    }
+    _header = (FingerprintIndexHeader *)addr;
+    if (created) {
+        _header->capacity = (_map_len - sizeof(FingerprintIndexHeader)) / sizeof(FingerprintEntry);
+        memcpy(_header->magic, MAGIC, sizeof(MAGIC));
+    }
+    unlock();
+
+    if (memcmp(_header->magic, MAGIC, sizeof(MAGIC)) != 0 || _map_len != get_map_len(_header->capacity)) {
+        cerr << "FingerprintIndex: " << path << " is not an index" << endl;
+        return;
+    }
+    _entries = (FingerprintEntry *)(_header + 1);
+    _ok = true;
+}
+
+FingerprintIndex::~FingerprintIndex()
+{
+    if (_header) {
+        munmap(_header, _map_len);
+    }
+    if (_fd >= 0) {
+        close(_fd);
+    }
+}
+
+void FingerprintIndex::lock() {
+    _lock.lock();
+    flock(_fd, LOCK_EX);
+}
+
+void FingerprintIndex::unlock() {
+    flock(_fd, LOCK_UN);
+    _lock.unlock();
+}
+
+#endif
+
+size_t FingerprintIndex::get_capacity() const {
+    return _ok ? (size_t)_header->capacity : 0;
+}
+
+size_t FingerprintIndex::get_count() const {
+    return _ok ? (size_t)_header->count : 0;
+}
+
+size_t FingerprintIndex::get_slot(fingerprint_t fingerprint) const {
+    // The two 31 bit hashes are in the low bits of each half. Mix them so
+    //  all the bits pick the slot
+    fingerprint_t h = fingerprint * 0x9E3779B97F4A7C15ULL;
+    return (size_t)(h ^ (h >> 32)) & (_header->capacity - 1);
+}
+
+const FingerprintEntry *FingerprintIndex::find(fingerprint_t fingerprint, size_t page_len) const {
+    if (!_ok) {
+        return 0;
+    }
+    fingerprint_t key = get_key(fingerprint);
+    size_t mask = _header->capacity - 1;
+    // Linear probing. The table is never full so this ends at an empty slot
+    for (size_t slot = get_slot(key); ; slot = (slot + 1) & mask) {
+        const FingerprintEntry *entry = &_entries[slot];
+        fingerprint_t k = load_key(entry);
+        if (k == 0) {
+            return 0;
+        }
+        if (k == key && entry->page_len == page_len) {
+            return entry;
+        }
+    }
+}
+
+bool FingerprintIndex::add(fingerprint_t fingerprint, size_t page_len, unsigned int job_id, unsigned int page) {
+    if (!_ok) {
+        return false;
+    }
+    lock();
+    bool added = false;
+    fingerprint_t key = get_key(fingerprint);
+    size_t mask = _header->capacity - 1;
+    if (!find(fingerprint, page_len) && _header->count + 1 <= _header->capacity / 4 * 3) {
+        size_t slot = get_slot(key);
+        while (load_key(&_entries[slot]) != 0) {
+            slot = (slot + 1) & mask;
+        }
+        FingerprintEntry *entry = &_entries[slot];
+        entry->page_len = page_len;
+        entry->job_id = job_id;
+        entry->page = page;
+        store_key(entry, key);
+        _header->count++;
+        added = true;
+    }
+    unlock();
+    return added;
+}
+
+size_t FingerprintIndex::match_pages(const PageIndex &index, const vector<fingerprint_t> &page_hashes,
+                                     int *job_id) const {
+    size_t num_known = 0;
+    *job_id = -1;
+    for (size_t i = 0; i < index.get_num_pages(); i++) {
+        const FingerprintEntry *entry = find(page_hashes[i], index.ends[i] - index.starts[i]);
+        if (!entry) {
+            continue;
+        }
+        if (num_known == 0) {
+            *job_id = (int)entry->job_id;
+        } else if (*job_id != (int)entry->job_id) {
+            *job_id = -1;
+        }
+        num_known++;
+    }
+    if (num_known < index.get_num_pages()) {
+        *job_id = -1;
+    }
+    return num_known;
+}
+
+size_t FingerprintIndex::add_pages(const PageIndex &index, const vector<fingerprint_t> &page_hashes,
+                                   unsigned int job_id) {
+    size_t num_added = 0;
+    for (size_t i = 0; i < index.get_num_pages(); i++) {
+        if (add(page_hashes[i], index.ends[i] - index.starts[i], job_id, (unsigned int)i)) {
+            num_added++;
+        }
+    }
+    return num_added;
+}
@@ -0,0 +1,94 @@
+#ifndef FINGERPRINT_INDEX_H
+#define FINGERPRINT_INDEX_H
+
+#include <vector>
+#include <mutex>
+#include "BinString.h"
+#include "RollingHash.h"
+#include "PageIndex.h"
+
+// Slots in a new index file. 24 bytes each, so the default is 24 MB
+#define FINGERPRINT_INDEX_CAPACITY (1024*1024)
+
+// A page that has been seen before. Entries are stored in the index file as
+//  they are in memory, so a file is only read by the machine that wrote it
+struct FingerprintEntry {
+    fingerprint_t fingerprint;      // of the page content, 0 for an empty slot
+    unsigned long long page_len;
+    unsigned int job_id;            // first job the page was seen in
+    unsigned int page;              // page number in that job
+
+    FingerprintEntry(): fingerprint(0), page_len(0), job_id(0), page(0) {}
+};
+
+// At the start of an index file, followed by the entries
+struct FingerprintIndexHeader;
+
+/*
+ * Persistent index of the page fingerprints of earlier jobs, so a spool
+ *  that reprints an earlier job, or contains the same pages, is recognised
+ *  from its page fingerprints alone: P hash table lookups for P pages.
+ * The index is an open addressing hash table in a file that is
+ *  memory-mapped shared. Opening it costs nothing whatever its size, and
+ *  several processes can use the same file at once, as can several threads
+ *  the same FingerprintIndex. Writers take a lock on the file and on the
+ *  object. Readers do not: an entry's fingerprint is written last, so a
+ *  reader sees either the whole entry or an empty slot.
+ * The table does not grow. add() fails once it is 3/4 full.
+ */
+class FingerprintIndex
+{
+    FingerprintIndexHeader *_header;
+    FingerprintEntry *_entries;
+    size_t _map_len;
+    bool _ok;
+#ifdef _WIN32
+    void *_file;
+    void *_mapping;
+#else
+    int _fd;
+#endif
+    // The file lock only excludes other processes: every thread of this one
+    //  holds it through the same descriptor. This excludes the threads
+    std::mutex _lock;
+
+    // Not copyable. The mapping is owned by exactly one object.
+    FingerprintIndex(const FingerprintIndex &);
+    FingerprintIndex &operator=(const FingerprintIndex &);
+
+    void lock();
+    void unlock();
+    size_t get_slot(fingerprint_t fingerprint) const;
+
+public:
+    // Open the index at path, creating it with capacity slots if it does
+    //  not exist. The capacity of an existing index is kept
+    FingerprintIndex(const char *path, size_t capacity = FINGERPRINT_INDEX_CAPACITY);
+    ~FingerprintIndex();
+
+    bool is_open() const { return _ok; }
+    size_t get_capacity() const;
+    size_t get_count() const;
+
+    // The entry for a page with this fingerprint and length, NULL if there
+    //  is none
+    const FingerprintEntry *find(fingerprint_t fingerprint, size_t page_len) const;
+
+    // Record a page. Returns false if the page is already known (the first
+    //  job it was seen in is kept) or the index is full
+    bool add(fingerprint_t fingerprint, size_t page_len, unsigned int job_id, unsigned int page);
+
+    // Look up every page in index, whose fingerprints are page_hashes (from
+    //  page_fingerprints()). Returns the number of known pages and the job
+    //  they all come from in *job_id, or -1 if they do not all come from one
+    //  job
+    size_t match_pages(const PageIndex &index, const std::vector<fingerprint_t> &page_hashes,
+                       int *job_id) const;
+
+    // add() every page in index as page i of job_id. Returns the number of
+    //  new pages
+    size_t add_pages(const PageIndex &index, const std::vector<fingerprint_t> &page_hashes,
+                     unsigned int job_id);
+};
+
+#endif
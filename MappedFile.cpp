@@ -0,0 +1,118 @@
+#include <iostream>
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const char *path):
+    _data(0),
+    _len(0),
+    _ok(false),
+    _file(INVALID_HANDLE_VALUE),
+    _mapping(0)
+{
+    // FILE_FLAG_SEQUENTIAL_SCAN is the Windows equivalent of MADV_SEQUENTIAL
+    _file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (_file == INVALID_HANDLE_VALUE) {
+        cerr << "MappedFile: cannot open " << path << endl;
+        return;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(_file, &size)) {
+        cerr << "MappedFile: cannot get size of " << path << endl;
+        return;
+    }
+    _len = (size_t)size.QuadPart;
+    if (_len == 0) {
+        _ok = true;
+        return;
+    }
+
+    _mapping = CreateFileMappingA(_file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!_mapping) {
+        cerr << "MappedFile: cannot map " << path << endl;
+        return;
+    }
+    _data = (const byte *)MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!_data) {
+        cerr << "MappedFile: cannot map view of " << path << endl;
+        return;
+    }
+    _ok = true;
+}
+
+MappedFile::~MappedFile()
+{
+    if (_data) {
+        UnmapViewOfFile(_data);
+    }
+    if (_mapping) {
+        CloseHandle(_mapping);
+    }
+    if (_file != INVALID_HANDLE_VALUE) {
+        CloseHandle(_file);
+    }
+}
+
+#else
+
+MappedFile::MappedFile(const char *path):
+    _data(0),
+    _len(0),
+    _ok(false),
+    _fd(-1)
+{
+    _fd = open(path, O_RDONLY);
+    if (_fd < 0) {
+        cerr << "MappedFile: cannot open " << path << endl;
+        return;
+    }
+
+    struct stat st;
+    if (fstat(_fd, &st) != 0) {
+        cerr << "MappedFile: cannot stat " << path << endl;
+        return;
+    }
+    _len = (size_t)st.st_size;
+    if (_len == 0) {
+        _ok = true;
+        return;
+    }
+
+    void *addr = mmap(NULL, _len, PROT_READ, MAP_SHARED, _fd, 0);
+    if (addr == MAP_FAILED) {
+        cerr << "MappedFile: cannot map " << path << endl;
+        return;
+    }
+    _data = (const byte *)addr;
+
+    // The detector reads front to back, so ask the kernel for aggressive
+    // readahead and to drop pages behind us. These are only hints.
+    madvise(addr, _len, MADV_SEQUENTIAL);
+    madvise(addr, _len, MADV_WILLNEED);
+    _ok = true;
+}
+
+MappedFile::~MappedFile()
+{
+    if (_data) {
+        munmap((void *)_data, _len);
+    }
+    if (_fd >= 0) {
+        close(_fd);
+    }
+}
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <stddef.h>
+#include "BinString.h"
+
+// Read-only, zero-copy view of a file on disk.
+// The file is memory-mapped so that spool files of many GB can be scanned
+// in place. Resident memory is bounded by the page cache rather than by the
+// size of the file, and nothing is copied into a BinString.
+class MappedFile
+{
+    const byte *_data;
+    size_t _len;
+    bool _ok;
+#ifdef _WIN32
+    void *_file;
+    void *_mapping;
+#else
+    int _fd;
+#endif
+
+    // Not copyable. The mapping is owned by exactly one object.
+    MappedFile(const MappedFile &);
+    MappedFile &operator=(const MappedFile &);
+
+public:
+    MappedFile(const char *path);
+    ~MappedFile();
+
+    bool is_open() const { return _ok; }
+    size_t get_len() const  { return _len; }
+    const byte *get_data() const { return _data; }
+};
+
+#endif
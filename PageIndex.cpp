@@ -0,0 +1,308 @@
+#include <string.h>
+#include <algorithm>
+#include "PageIndex.h"
+
+using namespace std;
+
+#define ESC 0x1b
+#define FF 0x0c
+
+// How far into a file the sniffers look
+#define SNIFF_LEN 4096
+
+static const char UEL[] = "\x1b%-12345X";
+static const size_t UEL_LEN = sizeof(UEL) - 1;
+
+static bool starts_with(const byte *data, size_t len, size_t pos, const char *s) {
+    size_t n = strlen(s);
+    return pos + n <= len && memcmp(data + pos, s, n) == 0;
+}
+
+// Offset after the end of the line that pos is in
+static size_t next_line(const byte *data, size_t len, size_t pos) {
+    const byte *nl = (const byte *)memchr(data + pos, '\n', len - pos);
+    return nl ? nl - data + 1 : len;
+}
+
+// Skip job control that may come before a page: universal exits, PJL lines,
+//  PCL resets (ESC E) and line ends
+static size_t skip_job_control(const byte *data, size_t len, size_t pos) {
+    while (pos < len) {
+        if (starts_with(data, len, pos, UEL)) {
+            pos += UEL_LEN;
+        } else if (starts_with(data, len, pos, "@PJL")) {
+            pos = next_line(data, len, pos);
+        } else if (data[pos] == ESC && pos + 1 < len && data[pos + 1] == 'E') {
+            pos += 2;
+        } else if (data[pos] == '\r' || data[pos] == '\n') {
+            pos++;
+        } else {
+            break;
+        }
+    }
+    return pos;
+}
+
+/*
+ * Offset after the PCL escape sequence at data[pos].
+ * Parameterized sequences are ESC, a character in '!'..'/', an optional
+ *  group character in '`'..'~', then value/parameter pairs such as "100W".
+ *  A lower case parameter continues the sequence and an upper case one ends
+ *  it. W parameters (raster rows, fonts, ...) and ESC &p#X (transparent print)
+ *  are followed by value bytes of binary data, which may contain form feeds
+ *  and escapes, so they are skipped
+ */
+static size_t skip_pcl_escape(const byte *data, size_t len, size_t pos) {
+    if (pos + 1 >= len) {
+        return len;
+    }
+    byte c = data[pos + 1];
+    if (c < '!' || c > '/') {
+        // Two character sequence such as ESC E
+        return pos + 2;
+    }
+    size_t p = pos + 2;
+    byte group = 0;
+    if (p < len && data[p] >= '`' && data[p] <= '~') {
+        group = data[p++];
+    }
+    while (p < len) {
+        size_t value = 0;
+        if (data[p] == '+' || data[p] == '-') {
+            p++;
+        }
+        while (p < len && data[p] >= '0' && data[p] <= '9') {
+            value = value * 10 + (data[p++] - '0');
+        }
+        if (p < len && data[p] == '.') {
+            p++;
+            while (p < len && data[p] >= '0' && data[p] <= '9') {
+                p++;
+            }
+        }
+        if (p >= len) {
+            return len;
+        }
+        byte param = data[p++];
+        if (param < '@' || param > '~') {
+            // Not PCL. Carry on from here
+            return p;
+        }
+        byte upper = param & ~0x20;
+        if (upper == 'W' || (c == '&' && group == 'p' && upper == 'X')) {
+            p += min(value, len - p);
+        }
+        if (param <= '^') {
+            return p;
+        }
+    }
+    return p;
+}
+
+void index_pcl_pages(const byte *data, size_t len, PageIndex *index) {
+    index->clear();
+    size_t page_start = skip_job_control(data, len, 0);
+    size_t i = page_start;
+    while (i < len) {
+        if (data[i] == ESC) {
+            i = skip_pcl_escape(data, len, i);
+        } else if (data[i] == FF) {
+            index->add_page(page_start, i + 1);
+            i = skip_job_control(data, len, i + 1);
+            page_start = i;
+        } else {
+            i++;
+        }
+    }
+    // A last page without a form feed
+    if (page_start < len) {
+        index->add_page(page_start, len);
+    }
+}
+
+/*
+ * A page is the text after a %%Page: line up to the next %%Page:, %%Trailer
+ *  or %%EOF line or universal exit. The %%Page: line itself is left out as
+ *  its page number differs from copy to copy
+ */
+void index_postscript_pages(const byte *data, size_t len, PageIndex *index) {
+    index->clear();
+    bool in_page = false;
+    size_t page_start = 0;
+    for (size_t line = 0; line < len; line = next_line(data, len, line)) {
+        bool is_page = starts_with(data, len, line, "%%Page:");
+        bool ends_page = is_page || starts_with(data, len, line, "%%Trailer") || starts_with(data, len, line, "%%EOF")
+            || starts_with(data, len, line, UEL);
+        if (ends_page && in_page) {
+            index->add_page(page_start, line);
+            in_page = false;
+        }
+        if (is_page) {
+            page_start = next_line(data, len, line);
+            in_page = true;
+        }
+    }
+    if (in_page) {
+        index->add_page(page_start, len);
+    }
+}
+
+void index_form_feed_pages(const byte *data, size_t len, PageIndex *index) {
+    index->clear();
+    size_t page_start = 0;
+    while (page_start < len) {
+        const byte *ff = (const byte *)memchr(data + page_start, FF, len - page_start);
+        size_t page_end = ff ? ff - data + 1 : len;
+        index->add_page(page_start, page_end);
+        page_start = page_end;
+    }
+}
+
+static bool sniff_postscript(const byte *data, size_t len) {
+    size_t pos = skip_job_control(data, len, 0);
+    if (starts_with(data, len, pos, "%!")) {
+        return true;
+    }
+    // PJL may say so
+    size_t n = min(len, (size_t)SNIFF_LEN);
+    const char *tag = "LANGUAGE=POSTSCRIPT";
+    size_t tag_len = strlen(tag);
+    for (size_t i = 0; i + tag_len <= n; i++) {
+        if (memcmp(data + i, tag, tag_len) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool sniff_pcl(const byte *data, size_t len) {
+    size_t pos = skip_job_control(data, len, 0);
+    return pos < len && data[pos] == ESC;
+}
+
+static bool sniff_any(const byte *, size_t) {
+    return true;
+}
+
+static const PageFormat BUILT_IN_FORMATS[] = {
+    {"postscript", sniff_postscript, index_postscript_pages},
+    {"pcl", sniff_pcl, index_pcl_pages},
+    {"form feed", sniff_any, index_form_feed_pages}
+};
+static const int NUM_BUILT_IN_FORMATS = sizeof(BUILT_IN_FORMATS) / sizeof(BUILT_IN_FORMATS[0]);
+
+static vector<PageFormat> _added_formats;
+
+void add_page_format(const PageFormat &format) {
+    _added_formats.push_back(format);
+}
+
+const PageFormat *find_page_format(const byte *data, size_t len) {
+    for (size_t i = _added_formats.size(); i > 0; i--) {
+        if (_added_formats[i - 1].sniff(data, len)) {
+            return &_added_formats[i - 1];
+        }
+    }
+    for (int i = 0; i < NUM_BUILT_IN_FORMATS; i++) {
+        if (BUILT_IN_FORMATS[i].sniff(data, len)) {
+            return &BUILT_IN_FORMATS[i];
+        }
+    }
+    return &BUILT_IN_FORMATS[NUM_BUILT_IN_FORMATS - 1];
+}
+
+const PageFormat *index_pages(const byte *data, size_t len, PageIndex *index) {
+    const PageFormat *format = find_page_format(data, len);
+    format->index(data, len, index);
+    return format;
+}
+
+void chunk_pages(size_t len, size_t chunk_size, PageIndex *index) {
+    index->clear();
+    for (size_t start = 0; start < len; start += chunk_size) {
+        index->add_page(start, min(start + chunk_size, len));
+    }
+}
+
+void page_fingerprints(const byte *data, size_t, const PageIndex &index,
+                       vector<fingerprint_t> *page_hashes, ScanStats *stats) {
+    size_t num_pages = index.get_num_pages();
+    page_hashes->resize(num_pages);
+    for (size_t i = 0; i < num_pages; i++) {
+        size_t page_len = index.ends[i] - index.starts[i];
+        (*page_hashes)[i] = RollingHash::hash(data + index.starts[i], page_len);
+        if (stats) {
+            stats->bytes_read += page_len;
+        }
+    }
+}
+
+// Pages i and j of index are the same
+static bool same_page(const PageIndex &index, const vector<fingerprint_t> &page_hashes, size_t i, size_t j) {
+    return index.ends[i] - index.starts[i] == index.ends[j] - index.starts[j] && page_hashes[i] == page_hashes[j];
+}
+
+CopyLayout page_table_layout(const PageIndex &index, const vector<fingerprint_t> &page_hashes,
+                             size_t num_copies) {
+    size_t num_pages = index.get_num_pages();
+    if (num_copies <= 1 || num_pages % num_copies != 0) {
+        return LAYOUT_NONE;
+    }
+    // Collated: page j is the same as page j + k*P/K
+    size_t copy_pages = num_pages / num_copies;
+    bool match = true;
+    for (size_t i = copy_pages; i < num_pages && match; i++) {
+        match = same_page(index, page_hashes, i, i - copy_pages);
+    }
+    if (match) {
+        return LAYOUT_COLLATED;
+    }
+    // Uncollated: pages come in runs of K that are the same
+    match = true;
+    for (size_t i = 0; i < num_pages && match; i++) {
+        match = i % num_copies == 0 || same_page(index, page_hashes, i, i - 1);
+    }
+    return match ? LAYOUT_UNCOLLATED : LAYOUT_NONE;
+}
+
+int page_find_num_copies(const byte *data, size_t len, const PageIndex &index,
+                         const vector<int> &numcopies_candidates, bool confirm,
+                         vector<fingerprint_t> *page_hashes, vector<size_t> *offsets,
+                         CopyLayout *layout, ScanStats *stats) {
+    const vector<size_t> &starts = index.starts;
+    const vector<size_t> &ends = index.ends;
+    size_t num_pages = index.get_num_pages();
+    offsets->clear();
+    *layout = LAYOUT_NONE;
+
+    page_fingerprints(data, len, index, page_hashes, stats);
+
+    for (unsigned int c = 0; c < numcopies_candidates.size(); c++) {
+        size_t num_copies = numcopies_candidates[c];
+        CopyLayout found = page_table_layout(index, *page_hashes, num_copies);
+        if (found == LAYOUT_NONE) {
+            continue;
+        }
+        // Each page is compared with the one before it in the same layout
+        size_t step = found == LAYOUT_COLLATED ? num_pages / num_copies : 1;
+        bool match = true;
+        for (size_t i = step; i < num_pages && match && confirm; i++) {
+            if (found == LAYOUT_UNCOLLATED && i % num_copies == 0) {
+                continue;
+            }
+            size_t page_len = ends[i] - starts[i];
+            match = memcmp(data + starts[i - step], data + starts[i], page_len) == 0;
+            if (stats) {
+                stats->bytes_read += 2 * page_len;
+            }
+        }
+        if (match) {
+            for (size_t k = 0; k < num_copies; k++) {
+                offsets->push_back(starts[k * step]);
+            }
+            *layout = found;
+            return (int)num_copies;
+        }
+    }
+    return -1;
+}
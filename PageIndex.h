@@ -0,0 +1,90 @@
+#ifndef PAGE_INDEX_H
+#define PAGE_INDEX_H
+
+#include <vector>
+#include "BinString.h"
+#include "RollingHash.h"
+#include "inline_copies.h"
+
+// Where the pages of a spool file are. Page i is data[starts[i]..ends[i]).
+//  Job control between pages, such as PJL, PCL resets and PostScript %%Page:
+//  comments, is not part of any page so it may differ from copy to copy
+struct PageIndex {
+    std::vector<size_t> starts;
+    std::vector<size_t> ends;
+
+    size_t get_num_pages() const { return starts.size(); }
+    void clear() { starts.clear(); ends.clear(); }
+    void add_page(size_t start, size_t end) { starts.push_back(start); ends.push_back(end); }
+};
+
+// true if data looks like this format
+typedef bool (*page_sniff_t)(const byte *data, size_t len);
+// Find the pages in data in a single pass
+typedef void (*page_index_t)(const byte *data, size_t len, PageIndex *index);
+
+// A page description language that index_pages() understands
+struct PageFormat {
+    const char *name;
+    page_sniff_t sniff;
+    page_index_t index;
+};
+
+// Add a format. Formats are tried most recently added first, then the built
+//  in ones: PostScript, PCL (with or without PJL) and finally form feeds
+void add_page_format(const PageFormat &format);
+
+// The format of data. Never NULL as anything can be split at form feeds
+const PageFormat *find_page_format(const byte *data, size_t len);
+
+// Index the pages of data using find_page_format(). Returns the format used
+const PageFormat *index_pages(const byte *data, size_t len, PageIndex *index);
+
+// The built in indexers
+void index_pcl_pages(const byte *data, size_t len, PageIndex *index);
+void index_postscript_pages(const byte *data, size_t len, PageIndex *index);
+void index_form_feed_pages(const byte *data, size_t len, PageIndex *index);
+
+// data[0..len) cut into chunk_size byte pieces, the last one shorter, as the
+//  pages of index. For fingerprinting input whose pages are not indexed
+void chunk_pages(size_t len, size_t chunk_size, PageIndex *index);
+
+// Fingerprint of every page in index, in one pass over the pages
+void page_fingerprints(const byte *data, size_t len, const PageIndex &index,
+                       std::vector<fingerprint_t> *page_hashes, ScanStats *stats = 0);
+
+// How the pages of the copies are ordered
+enum CopyLayout {
+    LAYOUT_NONE,            // no copies
+    LAYOUT_COLLATED,        // the whole document repeats: ABCABC
+    LAYOUT_UNCOLLATED       // each page repeats: AAABBBCCC
+};
+
+// Whether the P pages in index, whose fingerprints are page_hashes, are
+//  num_copies collated or uncollated copies. Pages are the same if they have
+//  the same length and fingerprint. Only the table is read, in O(P). If the
+//  pages fit both layouts, as when every page is the same, they are collated
+CopyLayout page_table_layout(const PageIndex &index, const std::vector<fingerprint_t> &page_hashes,
+                             size_t num_copies);
+
+/*
+ * Copies at page breaks. Unlike the other engines, copies do not have to be
+ *  len/num_copies bytes long, as pages differ in size and there may be job
+ *  control before, between and after the copies.
+ * Every page is fingerprinted in one pass, then page_table_layout() tests
+ *  each candidate against the fingerprints alone, so both collated and
+ *  uncollated copies are found without reading the data again. If confirm
+ *  is true the pages of the winning candidate are then compared with
+ *  memcmp, which reads them a second time.
+ * Candidates must be factors of the number of pages in index, largest first.
+ * Returns the largest number of copies found or -1, their layout in *layout
+ *  and the offset of the first page of each copy in offsets. Uncollated
+ *  copies are interleaved, so copy k is pages k, k + K, k + 2K... and its
+ *  offset is that of page k. page_hashes is scratch space
+ */
+int page_find_num_copies(const byte *data, size_t len, const PageIndex &index,
+                         const std::vector<int> &numcopies_candidates, bool confirm,
+                         std::vector<fingerprint_t> *page_hashes, std::vector<size_t> *offsets,
+                         CopyLayout *layout, ScanStats *stats = 0);
+
+#endif
@@ -0,0 +1,91 @@
+#include "RollingHash.h"
+
+typedef unsigned long long uint64;
+
+#define HASH_MOD  0x7fffffffULL
+#define HASH_BASE_1 1000003ULL
+#define HASH_BASE_2 740124023ULL
+
+// x mod 2^31-1 for x < 2^63
+static inline uint64 reduce(uint64 x) {
+    x = (x & HASH_MOD) + (x >> 31);
+    x = (x & HASH_MOD) + (x >> 31);
+    return x >= HASH_MOD ? x - HASH_MOD : x;
+}
+
+static inline uint64 mul_mod(uint64 a, uint64 b) {
+    return reduce(a * b);
+}
+
+static uint64 pow_mod(uint64 base, size_t n) {
+    uint64 result = 1;
+    while (n) {
+        if (n & 1) {
+            result = mul_mod(result, base);
+        }
+        base = mul_mod(base, base);
+        n >>= 1;
+    }
+    return result;
+}
+
+// Powers base^0..base^8 of one of the bases
+struct Powers {
+    uint64 b[9];
+    Powers(uint64 base) {
+        b[0] = 1;
+        for (int i = 1; i <= 8; i++) {
+            b[i] = mul_mod(b[i-1], base);
+        }
+    }
+};
+
+// d[0]*B^7 + d[1]*B^6 + ... + d[7], not reduced (< 2^42)
+static inline uint64 block8(const byte *d, const uint64 *b) {
+    return d[0] * b[7] + d[1] * b[6] + d[2] * b[5] + d[3] * b[4]
+         + d[4] * b[3] + d[5] * b[2] + d[6] * b[1] + d[7];
+}
+
+// h = h*B^len + data[0]*B^(len-1) + ... + data[len-1]  (mod 2^31-1) for both
+//  bases. Bytes are consumed 8 at a time so there is only one multiply in each
+//  loop-carried dependency chain per 8 bytes, and the two chains interleave
+void RollingHash::update(const byte *data, size_t len) {
+    static const Powers p1(HASH_BASE_1);
+    static const Powers p2(HASH_BASE_2);
+    uint64 h1 = _h1;
+    uint64 h2 = _h2;
+
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        h1 = reduce(h1 * p1.b[8] + block8(data + i, p1.b));
+        h2 = reduce(h2 * p2.b[8] + block8(data + i, p2.b));
+    }
+    for (; i < len; i++) {
+        h1 = reduce(h1 * HASH_BASE_1 + data[i]);
+        h2 = reduce(h2 * HASH_BASE_2 + data[i]);
+    }
+    _h1 = (unsigned int)h1;
+    _h2 = (unsigned int)h2;
+}
+
+fingerprint_t RollingHash::hash(const byte *data, size_t len) {
+    RollingHash h;
+    h.update(data, len);
+    return h.get();
+}
+
+fingerprint_t RollingHash::power(size_t n) {
+    return (pow_mod(HASH_BASE_1, n) << 32) | pow_mod(HASH_BASE_2, n);
+}
+
+fingerprint_t RollingHash::region(fingerprint_t h_start, fingerprint_t h_end, fingerprint_t pow_n) {
+    uint64 h1 = reduce((h_end >> 32) + HASH_MOD - mul_mod(h_start >> 32, pow_n >> 32));
+    uint64 h2 = reduce((h_end & 0xffffffff) + HASH_MOD - mul_mod(h_start & 0xffffffff, pow_n & 0xffffffff));
+    return (h1 << 32) | h2;
+}
+
+fingerprint_t RollingHash::concat(fingerprint_t h_start, fingerprint_t h_region, fingerprint_t pow_n) {
+    uint64 h1 = reduce(mul_mod(h_start >> 32, pow_n >> 32) + (h_region >> 32));
+    uint64 h2 = reduce(mul_mod(h_start & 0xffffffff, pow_n & 0xffffffff) + (h_region & 0xffffffff));
+    return (h1 << 32) | h2;
+}
\ No newline at end of file
@@ -0,0 +1,40 @@
+#ifndef ROLLING_HASH_H
+#define ROLLING_HASH_H
+
+#include <stddef.h>
+#include "BinString.h"
+
+// 64 bit fingerprint made of two 31 bit polynomial hashes
+typedef unsigned long long fingerprint_t;
+
+// Polynomial hash of a byte stream modulo the Mersenne prime 2^31-1,
+// computed with two different bases.
+// A RollingHash is a prefix hash: after update() it holds H(data[0..n)).
+// The fingerprint of any region data[a..b) can be recovered from the prefix
+// hashes at a and b, so a single linear pass fingerprints every region.
+class RollingHash
+{
+    unsigned int _h1;
+    unsigned int _h2;
+public:
+    RollingHash(): _h1(0), _h2(0) {}
+
+    void update(const byte *data, size_t len);
+    fingerprint_t get() const { return ((fingerprint_t)_h1 << 32) | _h2; }
+
+    // Fingerprint of data[0..len)
+    static fingerprint_t hash(const byte *data, size_t len);
+
+    // Base^n for both bases. Needed to compute region fingerprints
+    static fingerprint_t power(size_t n);
+
+    // Fingerprint of data[a..b) given H(data[0..a)), H(data[0..b)) and power(b-a)
+    static fingerprint_t region(fingerprint_t h_start, fingerprint_t h_end, fingerprint_t pow_n);
+
+    // Fingerprint of data[0..b) given H(data[0..a)), the fingerprint of
+    //  data[a..b) and power(b-a). The inverse of region(), so pieces of data
+    //  can be hashed separately and combined
+    static fingerprint_t concat(fingerprint_t h_start, fingerprint_t h_region, fingerprint_t pow_n);
+};
+
+#endif
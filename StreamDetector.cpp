@@ -0,0 +1,134 @@
+#include <iostream>
+#include "inline_copies.h"
+#include "StreamDetector.h"
+
+using namespace std;
+
+StreamDetector::StreamDetector(size_t total_len, int num_pages):
+    _total_len(total_len),
+    _pos(0),
+    _next_event(0),
+    _num_alive(0),
+    _num_hashed(0)
+{
+    // Same candidates as find_copies(). Copies must be the same length so
+    //  a candidate that does not divide the total length is ruled out now
+    vector<int> numcopies_candidates = get_factors(num_pages);
+    for (unsigned int i = 0; i < numcopies_candidates.size(); i++) {
+        int num_copies = numcopies_candidates[i];
+        if (total_len == 0 || total_len % num_copies != 0) {
+            continue;
+        }
+        Candidate c;
+        c.num_copies = num_copies;
+        c.copy_size = total_len / num_copies;
+        c.pow_copy = RollingHash::power(c.copy_size);
+        c.first_copy = 0;
+        c.copy_start = 0;
+        c.next_boundary = c.copy_size;
+        c.alive = true;
+        _candidates.push_back(c);
+        _num_alive++;
+    }
+    _update_next_event();
+}
+
+void StreamDetector::_update_next_event() {
+    _next_event = _total_len;
+    for (unsigned int i = 0; i < _candidates.size(); i++) {
+        const Candidate &c = _candidates[i];
+        if (c.alive && c.next_boundary < _next_event) {
+            _next_event = c.next_boundary;
+        }
+    }
+}
+
+// If num_copies copies do not match then neither can any multiple of
+//  num_copies, as its copies are made of num_copies copies
+void StreamDetector::_rule_out(int num_copies) {
+    for (unsigned int i = 0; i < _candidates.size(); i++) {
+        Candidate &c = _candidates[i];
+        if (c.alive && c.num_copies % num_copies == 0) {
+            c.alive = false;
+            _num_alive--;
+        }
+    }
+}
+
+// Called when _pos reaches _next_event. Check every candidate with a copy
+//  boundary here
+void StreamDetector::_process_boundary() {
+    fingerprint_t h = _hash.get();
+    for (unsigned int i = 0; i < _candidates.size(); i++) {
+        Candidate &c = _candidates[i];
+        if (!c.alive || c.next_boundary != _pos) {
+            continue;
+        }
+        fingerprint_t copy = RollingHash::region(c.copy_start, h, c.pow_copy);
+        if (c.next_boundary == c.copy_size) {
+            c.first_copy = copy;
+        } else if (copy != c.first_copy) {
+            _rule_out(c.num_copies);
+            continue;
+        }
+        c.copy_start = h;
+        c.next_boundary += c.copy_size;
+    }
+    _update_next_event();
+}
+
+void StreamDetector::push(const byte *chunk, size_t len) {
+    if (_pos + len > _total_len) {
+        cerr << "StreamDetector: pushed more than " << (double)_total_len << " bytes" << endl;
+        len = _total_len - _pos;
+    }
+    // Once every candidate has been ruled out there is nothing left to hash
+    if (_num_alive == 0) {
+        _pos += len;
+        return;
+    }
+    const byte *end = chunk + len;
+    while (chunk < end) {
+        size_t n = _next_event - _pos;
+        if (n > (size_t)(end - chunk)) {
+            n = end - chunk;
+        }
+        _hash.update(chunk, n);
+        _num_hashed += n;
+        chunk += n;
+        _pos += n;
+        if (_pos == _next_event) {
+            _process_boundary();
+            if (_num_alive == 0) {
+                _pos += end - chunk;
+                break;
+            }
+        }
+    }
+}
+
+int StreamDetector::finish() {
+    if (_pos != _total_len) {
+        return -1;
+    }
+    // Every surviving candidate has had all its copies checked
+    vector<int> candidates = get_candidates();
+    return candidates.size() > 0 ? candidates[0] : -1;
+}
+
+const vector<int> StreamDetector::get_candidates() const {
+    vector<int> candidates;
+    for (unsigned int i = 0; i < _candidates.size(); i++) {
+        if (_candidates[i].alive) {
+            candidates.push_back(_candidates[i].num_copies);
+        }
+    }
+    return candidates;
+}
+
+ScanStats StreamDetector::get_stats() const {
+    ScanStats stats;
+    stats.input_bytes = _pos;
+    stats.bytes_read = _num_hashed;
+    return stats;
+}
@@ -0,0 +1,71 @@
+#ifndef STREAM_DETECTOR_H
+#define STREAM_DETECTOR_H
+
+#include <vector>
+#include "BinString.h"
+#include "RollingHash.h"
+#include "inline_copies.h"
+
+// Inline copy detection for spools that arrive a chunk at a time.
+//
+//  StreamDetector detector(total_len, num_pages);
+//  while (...) detector.push(chunk, chunk_len);
+//  int num_copies = detector.finish();
+//
+// The candidate copy counts are the get_factors() of num_pages. For each one
+// we keep a fixed amount of state: the fingerprint of the first copy and the
+// prefix hash at the start of the current copy. Each time a copy boundary is
+// crossed the fingerprint of the copy just completed is compared with the
+// first copy's and the candidate is dropped on a mismatch.
+// Memory depends only on the number of candidates, not on the spool size,
+// and the result is available as soon as the last byte is pushed.
+// When K copies are ruled out so are all multiples of K, and once every
+// candidate is ruled out the rest of the input is not hashed at all.
+//
+// total_len must be known up front because it determines the copy boundaries.
+class StreamDetector
+{
+    struct Candidate {
+        int num_copies;
+        size_t copy_size;
+        fingerprint_t pow_copy;     // base^copy_size
+        fingerprint_t first_copy;   // fingerprint of first copy
+        fingerprint_t copy_start;   // prefix hash at start of current copy
+        size_t next_boundary;       // offset of end of current copy
+        bool alive;
+    };
+
+    const size_t _total_len;
+    size_t _pos;
+    size_t _next_event;
+    int _num_alive;
+    size_t _num_hashed;
+    RollingHash _hash;
+    std::vector<Candidate> _candidates;
+
+    void _process_boundary();
+    void _rule_out(int num_copies);
+    void _update_next_event();
+
+public:
+    StreamDetector(size_t total_len, int num_pages);
+
+    void push(const byte *chunk, size_t len);
+
+    // Return the number of copies or -1 if there are none
+    int finish();
+
+    // Candidates that have not been ruled out yet, largest first
+    const std::vector<int> get_candidates() const;
+
+    size_t get_num_pushed() const { return _pos; }
+
+    // Number of candidates not ruled out yet. Once it is 0 there is no need
+    //  to push any more
+    int get_num_alive() const { return _num_alive; }
+
+    // bytes_read is the number of bytes hashed so far
+    ScanStats get_stats() const;
+};
+
+#endif
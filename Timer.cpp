@@ -1,21 +1,12 @@
-#include <windows.h>
-#include "timer.h"
-
-double Timer::_get_absolute()
-{
-    LARGE_INTEGER time;
-    QueryPerformanceCounter(&time);
-    return time.QuadPart * _freq;
-}
-
-Timer::Timer() {
-    LARGE_INTEGER freq;
-    QueryPerformanceFrequency(&freq);
-    _freq = 1.0 / freq.QuadPart;
-    _time0 = _get_absolute();
-}
-
-double Timer::get()
-{
-    return _get_absolute() - _time0;
+#include "Timer.h"
+
+using namespace std::chrono;
+
+Timer::Timer() {
+    _time0 = steady_clock::now();
+}
+
+double Timer::get() const
+{
+    return duration_cast<duration<double> >(steady_clock::now() - _time0).count();
 }
\ No newline at end of file
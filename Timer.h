@@ -1,13 +1,19 @@
-
-class Timer {
-
-    double _freq;
-    double _time0;
-
-    double _get_absolute();
-
-public:
-    Timer();
-    double get();
-
-};
\ No newline at end of file
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <chrono>
+
+// Wall clock time in seconds since the Timer was created.
+// steady_clock is monotonic and is QueryPerformanceCounter on Windows and
+//  clock_gettime(CLOCK_MONOTONIC) on Linux
+class Timer {
+
+    std::chrono::steady_clock::time_point _time0;
+
+public:
+    Timer();
+    double get() const;
+
+};
+
+#endif
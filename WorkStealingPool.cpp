@@ -0,0 +1,108 @@
+#include "WorkStealingPool.h"
+
+using namespace std;
+
+// Index of the pool worker running on this thread, -1 on other threads
+static thread_local int _worker_index = -1;
+static thread_local const WorkStealingPool *_worker_pool = 0;
+
+WorkStealingPool::WorkStealingPool(int num_threads):
+    _next_worker(0),
+    _num_pending(0),
+    _stop(false)
+{
+    if (num_threads <= 0) {
+        num_threads = max(1, (int)thread::hardware_concurrency());
+    }
+    for (int i = 0; i < num_threads; i++) {
+        _workers.push_back(new Worker());
+    }
+    for (int i = 0; i < num_threads; i++) {
+        _threads.push_back(thread(&WorkStealingPool::run_worker, this, i));
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    wait();
+    {
+        lock_guard<mutex> guard(_idle_lock);
+        _stop = true;
+    }
+    _work_ready.notify_all();
+    for (unsigned int i = 0; i < _threads.size(); i++) {
+        _threads[i].join();
+    }
+    for (unsigned int i = 0; i < _workers.size(); i++) {
+        delete _workers[i];
+    }
+}
+
+void WorkStealingPool::submit(const Task &task) {
+    size_t w = (_worker_pool == this) ? _worker_index : _next_worker++ % _workers.size();
+    _num_pending++;
+    {
+        lock_guard<mutex> guard(_workers[w]->lock);
+        _workers[w]->tasks.push_back(task);
+    }
+    // Taking the lock orders this with a worker that is about to sleep
+    lock_guard<mutex> guard(_idle_lock);
+    _work_ready.notify_one();
+}
+
+// Newest task from worker's own queue, else the oldest from another's
+bool WorkStealingPool::pop_task(int worker, Task *task) {
+    {
+        Worker *w = _workers[worker];
+        lock_guard<mutex> guard(w->lock);
+        if (!w->tasks.empty()) {
+            *task = w->tasks.back();
+            w->tasks.pop_back();
+            return true;
+        }
+    }
+    for (size_t i = 1; i < _workers.size(); i++) {
+        Worker *victim = _workers[(worker + i) % _workers.size()];
+        lock_guard<mutex> guard(victim->lock);
+        if (!victim->tasks.empty()) {
+            *task = victim->tasks.front();
+            victim->tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::run_worker(int worker) {
+    _worker_index = worker;
+    _worker_pool = this;
+    Task task;
+    while (true) {
+        if (pop_task(worker, &task)) {
+            task();
+            task = Task();
+            if (--_num_pending == 0) {
+                lock_guard<mutex> guard(_idle_lock);
+                _all_done.notify_all();
+            }
+            continue;
+        }
+        unique_lock<mutex> guard(_idle_lock);
+        if (_stop) {
+            return;
+        }
+        // Tasks are only queued before notifying under _idle_lock, so a
+        //  pending task that is not running must be in a queue
+        if (_num_pending == 0) {
+            _work_ready.wait(guard);
+        } else {
+            _work_ready.wait_for(guard, chrono::milliseconds(1));
+        }
+    }
+}
+
+void WorkStealingPool::wait() {
+    unique_lock<mutex> guard(_idle_lock);
+    while (_num_pending != 0) {
+        _all_done.wait(guard);
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef WORK_STEALING_POOL_H
+#define WORK_STEALING_POOL_H
+
+#include <deque>
+#include <vector>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+/*
+ * Thread pool in which each worker has its own task queue.
+ * A task submitted from a worker goes on that worker's queue, which the
+ *  worker takes from newest first, so a task that splits itself into
+ *  sub-tasks keeps them hot in its own cache. A worker with an empty queue
+ *  steals the oldest task from another worker, so a few big jobs at the end
+ *  of a batch are shared out rather than left to one thread.
+ */
+class WorkStealingPool {
+public:
+    typedef std::function<void()> Task;
+
+private:
+    struct Worker {
+        std::mutex lock;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<Worker *> _workers;
+    std::vector<std::thread> _threads;
+    std::atomic<size_t> _next_worker;   // round robin for tasks submitted from outside
+    std::atomic<long> _num_pending;     // submitted but not finished
+    std::atomic<bool> _stop;
+    std::mutex _idle_lock;
+    std::condition_variable _work_ready;
+    std::condition_variable _all_done;
+
+    bool pop_task(int worker, Task *task);
+    void run_worker(int worker);
+
+    // Not copyable
+    WorkStealingPool(const WorkStealingPool &);
+    WorkStealingPool &operator=(const WorkStealingPool &);
+
+public:
+    // num_threads <= 0 means one per core
+    WorkStealingPool(int num_threads = 0);
+    ~WorkStealingPool();
+
+    int get_num_threads() const { return (int)_threads.size(); }
+
+    // Run task on the pool. May be called from a task
+    void submit(const Task &task);
+
+    // Wait until all tasks, including tasks they submitted, have finished
+    void wait();
+};
+
+#endif
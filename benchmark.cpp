@@ -0,0 +1,876 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <iostream>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include "BinString.h"
+#include "Timer.h"
+#include "boyer_moore.h"
+#include "BlockReader.h"
+#include "Detector.h"
+#include "make_copies.h"
+#include "inline_copies.h"
+
+/*
+ * Throughput benchmark for the copy detection engines
+ *
+ * benchmark [options] [num_pages num_copies copy_size]
+ *  -e engine   bm-raw (default), bm, hash, single, anchor, page, period or run
+ *  -r reps     timed repetitions per case (default 10)
+ *  -w warmup   untimed warm-up runs per case (default 2)
+ *  -t threads  search threads, <= 0 for all cores (default 1)
+ *  -s budget   windows sampled per candidate before a full check, 0 for none
+ *              (default 256, none with -a)
+ *  -o file     CSV file that results are appended to (default inline.copies.csv)
+ *  -j file     JSON file that results are written to
+ *  -l label    label for the results, e.g. a commit id
+ *
+ *  -f file     time reading and scanning a spool file instead, see below
+ *  -i mode     how -f reads the file: cached (default), cold or direct
+ *  -a size     run the worst cases from 1 KB up to size bytes instead, e.g. 64M
+ *  -p max_len  time the search kernels on pattern lengths up to max_len instead
+ *  -k kernel   search kernel: auto (default), bm, scalar, sse2 or avx2
+ *  -m size     search patterns of at least size bytes with Two-Way instead of
+ *              Boyer-Moore, 0 for never (default 256K)
+ *
+ * With no case on the command line the standard cases are run.
+ * page times copies of a PCL job instead, as it needs page breaks.
+ * bm-raw times a Boyer-Moore scan for the known copy size with the tables
+ *  built once, which is what the numbers in README.md are. The others time
+ *  find_copies() with that engine.
+ * Built with -DBM_STATS (the whole library, not just this file) it also
+ *  prints what the Boyer-Moore search did for each case: comparisons, shift
+ *  lengths, which delta table won and table build time against scan time.
+ *  These go in the CSV and JSON files either way, as 0 without BM_STATS.
+ * table MB is the most memory the search tables of one pattern took. It is
+ *  kept either way. Two-Way and the short pattern kernels take at most the
+ *  2 KB of delta1, the SIMD kernels nothing.
+ *
+ * benchmark -f spool_file num_pages compares the speed of finding copies in
+ *  a file with the speed of just reading it: read is a BlockReader that does
+ *  nothing with the blocks, stream feeds them to a StreamDetector as they
+ *  arrive and mmap runs a Detector on the memory-mapped file. cold drops the
+ *  file from the page cache before each run, direct also reads with
+ *  O_DIRECT. These are logged with num_copies 1 and copy_size the file size.
+ *
+ * benchmark -a 64M times the engines on the worst cases in
+ *  ADVERSARIAL_INPUTS, with sizes going up 16 times at a time, and fails if
+ *  the time per byte, relative to just reading the input, grows more than 4
+ *  times from 256 KB on. Up to 4G works
+ *  with enough memory: the Boyer-Moore tables for two copies take 8 times
+ *  the input size.
+ *
+ * benchmark -p 64 times finding every match of a pattern in random text, for
+ *  pattern lengths from 1 to 64 bytes and each search kernel: bm is
+ *  Boyer-Moore for every length, scalar uses the short pattern kernels in
+ *  boyer_moore.cpp up to 32 bytes and auto the SIMD ones where the CPU has
+ *  them. These are logged with num_pages the pattern length and found the
+ *  number of matches. -k picks the kernel for the other benchmarks.
+ */
+using namespace std;
+
+struct EngineName {
+    const char *name;
+    CopyEngine engine;
+    bool raw;
+};
+
+static const EngineName ENGINE_NAMES[] = {
+    {"bm-raw", ENGINE_BOYER_MOORE, true},
+    {"bm", ENGINE_BOYER_MOORE, false},
+    {"hash", ENGINE_ROLLING_HASH, false},
+    {"single", ENGINE_SINGLE_PASS, false},
+    {"anchor", ENGINE_SAMPLED_ANCHOR, false},
+    {"page", ENGINE_PAGE_INDEX, false},
+    {"period", ENGINE_PERIOD, false},
+    {"run", ENGINE_RUN_LENGTH, false}
+};
+static const int NUM_ENGINES = sizeof(ENGINE_NAMES) / sizeof(ENGINE_NAMES[0]);
+
+struct KernelName {
+    const char *name;
+    SearchKernel kernel;
+};
+
+static const KernelName KERNEL_NAMES[] = {
+    {"auto", KERNEL_AUTO},
+    {"bm", KERNEL_BOYER_MOORE},
+    {"scalar", KERNEL_SCALAR},
+    {"sse2", KERNEL_SSE2},
+    {"avx2", KERNEL_AVX2}
+};
+static const int NUM_KERNELS = sizeof(KERNEL_NAMES) / sizeof(KERNEL_NAMES[0]);
+
+struct BenchCase {
+    int num_pages;
+    int num_copies;
+    size_t copy_size;
+};
+
+static const BenchCase STANDARD_CASES[] = {
+    {4, 2, 40},
+    {20, 2, 891},
+    {40, 20, 50*1000},
+    {400, 200, 50*1000},
+    {400, 200, 500*1000},
+    {4000, 2000, 50*1000},
+    {400000, 200000, 5*100},
+    {400000, 200000, 5*1000},
+    {40, 20, 500*1000},
+    {34, 17, 500*1000},
+    {51, 17, 500*1000},
+    {68, 17, 500*1000}
+};
+static const int NUM_STANDARD_CASES = sizeof(STANDARD_CASES) / sizeof(STANDARD_CASES[0]);
+
+struct BenchResult {
+    BenchCase test;
+    const char *engine;
+    int reps;
+    int found_num_copies;
+    double build_duration;  // table build (sec), bm-raw only
+    double min_duration;    // per repetition (sec)
+    double median_duration;
+    double p99_duration;
+    SearchStats search;     // of the last repetition, 0 unless built with -DBM_STATS
+
+    double total_size() const {
+        return (double)test.num_copies * (double)test.copy_size / 1024.0 / 1024.0;
+    }
+    // Search tables (MB)
+    double table_size() const {
+        return (double)search.table_bytes / 1024.0 / 1024.0;
+    }
+    // MB/sec for a repetition that took duration
+    double speed(double duration) const {
+        return duration > 0.0 ? total_size() / duration : -1.0;
+    }
+};
+
+// q'th quantile of sorted durations by the nearest rank method
+static double quantile(const vector<double> &sorted, double q) {
+    size_t rank = (size_t)(q * sorted.size() + 0.999999);
+    rank = max(rank, (size_t)1);
+    return sorted[min(rank, sorted.size()) - 1];
+}
+
+/*
+ * Results are appended to a CSV file so that runs on different commits can be
+ *  compared. The JSON file holds the results of the latest run
+ */
+class Logger {
+    FILE* _f;
+    std::string _label;
+public:
+    Logger(const char *filename, const char *label): _label(label) {
+        FILE *existing = fopen(filename, "rt");
+        if (existing) {
+            fclose(existing);
+        }
+        _f = fopen(filename, "at");
+        if (!_f) {
+            cerr << "Could not open " << filename << endl;
+            return;
+        }
+        if (!existing) {
+            fprintf(_f, "%s, %s, %s, %s, %s, %s, %s, %s, %s, %s, %s, %s, %s, %s, %s, %s, %s, %s, %s, %s, %s, "
+                "%s, %s, %s\n",
+                "label", "engine", "num_pages", "num_copies", "copy_size (bytes)", "total_size (MB)", "reps",
+                "min (sec)", "median (sec)", "p99 (sec)",
+                "max speed (MB/sec)", "median speed (MB/sec)", "p99 speed (MB/sec)", "table build (sec)",
+                "patterns", "comparisons", "shifts", "average shift", "delta1 wins", "delta2 wins",
+                "bytes touched", "search build (sec)", "search scan (sec)", "search tables (bytes)");
+        }
+    }
+    ~Logger() {
+        if (_f) {
+            fclose(_f);
+        }
+    }
+    void log(const BenchResult &r) {
+        if (!_f) {
+            return;
+        }
+        const SearchStats &search = r.search;
+        fprintf(_f, "%s, %s, %5d, %4d, %8llu, %4.1f, %3d, %.9f, %.9f, %.9f, %8.3f, %8.3f, %8.3f, %.6f, "
+            "%llu, %llu, %llu, %.1f, %llu, %llu, %llu, %.6f, %.6f, %llu\n",
+            _label.c_str(), r.engine, r.test.num_pages, r.test.num_copies, (unsigned long long)r.test.copy_size,
+            r.total_size(), r.reps, r.min_duration, r.median_duration, r.p99_duration,
+            r.speed(r.min_duration), r.speed(r.median_duration), r.speed(r.p99_duration), r.build_duration,
+            search.num_patterns, search.comparisons, search.shifts, search.get_average_shift(),
+            search.delta1_wins, search.delta2_wins, search.bytes_touched, search.build_seconds,
+            search.scan_seconds, (unsigned long long)search.table_bytes);
+        fflush(_f);
+    }
+};
+
+static bool write_json(const char *filename, const char *label, const vector<BenchResult> &results) {
+    FILE *f = fopen(filename, "wt");
+    if (!f) {
+        cerr << "Could not open " << filename << endl;
+        return false;
+    }
+    fprintf(f, "{\n  \"label\": \"%s\",\n  \"results\": [\n", label);
+    for (unsigned int i = 0; i < results.size(); i++) {
+        const BenchResult &r = results[i];
+        fprintf(f, "    {\"engine\": \"%s\", \"num_pages\": %d, \"num_copies\": %d, \"copy_size\": %llu, "
+            "\"total_size_mb\": %.3f, \"reps\": %d, \"found_num_copies\": %d, "
+            "\"min_sec\": %.9f, \"median_sec\": %.9f, \"p99_sec\": %.9f, "
+            "\"max_mb_per_sec\": %.3f, \"median_mb_per_sec\": %.3f, \"p99_mb_per_sec\": %.3f, "
+            "\"table_build_sec\": %.9f, \"search\": {\"patterns\": %llu, \"comparisons\": %llu, "
+            "\"shifts\": %llu, \"average_shift\": %.1f, \"delta1_wins\": %llu, \"delta2_wins\": %llu, "
+            "\"bytes_touched\": %llu, \"build_sec\": %.9f, \"scan_sec\": %.9f, \"table_bytes\": %llu}}%s\n",
+            r.engine, r.test.num_pages, r.test.num_copies, (unsigned long long)r.test.copy_size,
+            r.total_size(), r.reps, r.found_num_copies,
+            r.min_duration, r.median_duration, r.p99_duration,
+            r.speed(r.min_duration), r.speed(r.median_duration), r.speed(r.p99_duration),
+            r.build_duration, r.search.num_patterns, r.search.comparisons, r.search.shifts,
+            r.search.get_average_shift(), r.search.delta1_wins, r.search.delta2_wins, r.search.bytes_touched,
+            r.search.build_seconds, r.search.scan_seconds, (unsigned long long)r.search.table_bytes,
+            i + 1 < results.size() ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+    fclose(f);
+    return true;
+}
+
+Timer _timer;
+
+/*
+ * Time reps runs of engine on test data bin_string, which is test.num_copies
+ *  copies of test.copy_size bytes (or not, if it is a worst case) after
+ *  warmup untimed runs
+ */
+static BenchResult run_benchmark(const BinString &bin_string, BenchCase test, const EngineName &engine,
+                                 int reps, int warmup) {
+    BenchResult result;
+    result.test = test;
+    result.engine = engine.name;
+    result.reps = reps;
+    result.build_duration = 0.0;
+
+    size_t patlen = bin_string.get_len()/test.num_copies;
+    const byte *pat = bin_string.get_data();
+    const byte *text = bin_string.get_data() + patlen;
+    size_t textlen = bin_string.get_len() - patlen;
+    size_t min_gap = (3 * patlen)/4;
+    CompiledPattern *pattern = 0;
+    vector<size_t> tables;
+    SearchStats search;
+    if (engine.raw) {
+        double tb = _timer.get();
+        pattern = new CompiledPattern(pat, patlen, &tables, &search);
+        result.build_duration = _timer.get() - tb;
+    }
+    // The pattern counts every repetition into search, so each starts again
+    //  from the build
+    const SearchStats build = search;
+
+    vector<double> durations;
+    for (int i = 0; i < warmup + reps; i++) {
+        double t0 = _timer.get();
+        if (engine.raw) {
+            search = build;
+            vector<const byte *> matches = pattern->find_all(text, textlen, min_gap);
+            result.found_num_copies = (int)matches.size() + 1;
+        } else {
+            ScanStats stats;
+            result.found_num_copies = find_copies(bin_string.get_data(), bin_string.get_len(), test.num_pages,
+                                                  engine.engine, &stats);
+            search = stats.search;
+        }
+        double t1 = _timer.get();
+        if (i >= warmup) {
+            durations.push_back(t1 - t0);
+        }
+    }
+    sort(durations.begin(), durations.end());
+    result.min_duration = durations.front();
+    result.median_duration = quantile(durations, 0.5);
+    result.p99_duration = quantile(durations, 0.99);
+    result.search = search;
+
+    delete pattern;
+    return result;
+}
+
+/*
+ * Time reps runs of engine on num_copies copies of copy_size bytes after
+ *  warmup untimed runs
+ */
+static BenchResult run_benchmark(BenchCase test, const EngineName &engine, int reps, int warmup) {
+    assert(test.num_pages >= test.num_copies);
+    assert(test.num_pages % test.num_copies == 0);
+    int pages_copy = test.num_pages / test.num_copies;
+    // Round up copy to next multiple of page per copy
+    test.copy_size = ((test.copy_size + pages_copy - 1)/pages_copy) * pages_copy;
+    const BinString *bin_string_ptr;
+    if (engine.engine == ENGINE_PAGE_INDEX) {
+        // The page index needs real page breaks. The copies are a bit bigger
+        //  than copy_size as they have PCL and PJL in them
+        bin_string_ptr = make_pcl_spool(test.num_copies, pages_copy, test.copy_size / pages_copy);
+        test.copy_size = bin_string_ptr->get_len() / test.num_copies;
+    } else {
+        bin_string_ptr = make_copies(test.num_copies, test.copy_size);
+    }
+    BenchResult result = run_benchmark(*bin_string_ptr, test, engine, reps, warmup);
+    delete bin_string_ptr;
+    return result;
+}
+
+// Ways benchmark -f scans a file
+enum FileMethod {FILE_READ, FILE_STREAM, FILE_MMAP, NUM_FILE_METHODS};
+static const char *FILE_METHOD_NAMES[NUM_FILE_METHODS] = {"read", "stream", "mmap"};
+
+// Drop path from the page cache so that the next read of it is from disk
+static void drop_from_cache(const char *path) {
+#ifdef POSIX_FADV_DONTNEED
+    int fd = open(path, O_RDONLY);
+    if (fd >= 0) {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+#endif
+}
+
+/*
+ * Time reps scans of the num_pages spool file at path with method after
+ *  warmup untimed ones
+ */
+static BenchResult run_file_benchmark(const char *path, int num_pages, FileMethod method, bool cold,
+                                      bool direct, int reps, int warmup) {
+    ReaderConfig config;
+    config.direct = direct;
+    DetectorConfig detector_config;
+    detector_config.engine = ENGINE_ROLLING_HASH;
+
+    BenchResult result;
+    result.test.num_pages = num_pages;
+    result.test.num_copies = 1;
+    result.test.copy_size = 0;
+    result.engine = FILE_METHOD_NAMES[method];
+    result.reps = reps;
+    result.found_num_copies = -1;
+    result.build_duration = 0.0;
+
+    vector<double> durations;
+    for (int i = 0; i < warmup + reps; i++) {
+        if (cold) {
+            drop_from_cache(path);
+        }
+        double t0 = _timer.get();
+        if (method == FILE_READ) {
+            BlockReader reader(path, config);
+            size_t len;
+            while (reader.next(&len)) {
+            }
+            result.test.copy_size = reader.get_len();
+        } else if (method == FILE_STREAM) {
+            ScanStats stats;
+            result.found_num_copies = stream_find_num_copies(path, num_pages, config, &stats);
+            result.test.copy_size = stats.input_bytes;
+        } else {
+            DetectorResult detected = Detector(detector_config).detect_file(path, num_pages);
+            result.found_num_copies = detected.num_copies;
+            result.test.copy_size = detected.stats.input_bytes;
+        }
+        double t1 = _timer.get();
+        if (i >= warmup) {
+            durations.push_back(t1 - t0);
+        }
+    }
+    sort(durations.begin(), durations.end());
+    result.min_duration = durations.front();
+    result.median_duration = quantile(durations, 0.5);
+    result.p99_duration = quantile(durations, 0.99);
+    return result;
+}
+
+// Worst case inputs for the engines, from the comment in inline_copies.cpp
+struct AdversarialInput {
+    const char *name;
+    int num_copies;                 // copies made. The inputs have twice as many pages
+    const BinString *(*make)(int num_copies, size_t copy_size);
+};
+
+static const AdversarialInput ADVERSARIAL_INPUTS[] = {
+    {"two", 2, make_copies},                // the Boyer-Moore pattern is half the file
+    {"end-diff", 4, make_end_diff_copies},  // every candidate fails at the last byte
+    {"blank", 4, make_blank_copies},        // every candidate matches everywhere
+    {"periodic", 4, make_periodic_copies},  // "121212..."
+    {"raster", 4, make_raster_copies}       // mostly blank with some marks on each row
+};
+static const int NUM_ADVERSARIAL_INPUTS = sizeof(ADVERSARIAL_INPUTS) / sizeof(ADVERSARIAL_INPUTS[0]);
+
+// The page engine is left out as it needs page breaks
+static const char *ADVERSARIAL_ENGINES[] = {"bm-raw", "bm", "hash", "single", "anchor", "period", "run"};
+static const int NUM_ADVERSARIAL_ENGINES = sizeof(ADVERSARIAL_ENGINES) / sizeof(ADVERSARIAL_ENGINES[0]);
+
+// Input sizes go from ADVERSARIAL_MIN_SIZE up by ADVERSARIAL_SIZE_STEP
+#define ADVERSARIAL_MIN_SIZE 1024
+#define ADVERSARIAL_SIZE_STEP 16
+// Time is measured in passes: multiples of the time to read the input once,
+//  so that inputs that no longer fit in the caches do not look slower per
+//  byte. From this size on the passes must stay within ADVERSARIAL_MAX_GROWTH
+//  times those at this size. Below it fixed costs dominate
+#define ADVERSARIAL_BOUND_SIZE (256*1024)
+#define ADVERSARIAL_MAX_GROWTH 4.0
+// Bigger inputs are timed once with no warm-up
+#define ADVERSARIAL_REPS_SIZE (64*1024*1024)
+
+// Number in bytes with an optional K, M or G suffix
+static size_t parse_size(const char *s) {
+    char *end;
+    double n = strtod(s, &end);
+    switch (*end) {
+    case 'K': case 'k': n *= 1024.0; break;
+    case 'M': case 'm': n *= 1024.0 * 1024.0; break;
+    case 'G': case 'g': n *= 1024.0 * 1024.0 * 1024.0; break;
+    }
+    return n > 0.0 ? (size_t)n : 0;
+}
+
+// So that the compiler cannot drop the memcmp() in read_duration()
+static volatile int _read_result;
+
+// Fastest of reps reads of input, comparing its two halves
+static double read_duration(const BinString &input, int reps) {
+    size_t half = input.get_len() / 2;
+    double duration = 0.0;
+    for (int i = 0; i < reps; i++) {
+        double t0 = _timer.get();
+        _read_result = memcmp(input.get_data(), input.get_data() + half, half);
+        double t1 = _timer.get();
+        duration = i == 0 ? t1 - t0 : min(duration, t1 - t0);
+    }
+    return duration;
+}
+
+// Largest candidate whose copies are exactly the same, by comparing them
+static int reference_num_copies(const BinString &input, int num_pages) {
+    vector<int> candidates = get_factors(num_pages);
+    size_t len = input.get_len();
+    const byte *data = input.get_data();
+    for (unsigned int i = 0; i < candidates.size(); i++) {
+        size_t num_copies = candidates[i];
+        if (len % num_copies != 0) {
+            continue;
+        }
+        size_t copy_size = len / num_copies;
+        bool match = true;
+        for (size_t k = 1; k < num_copies && match; k++) {
+            match = memcmp(data, data + k * copy_size, copy_size) == 0;
+        }
+        if (match) {
+            return (int)num_copies;
+        }
+    }
+    return -1;
+}
+
+// The size benchmark -a runs after size: ADVERSARIAL_SIZE_STEP times bigger
+//  but no more than max_size, so that max_size itself is always run. 0 once
+//  max_size has been run
+static size_t next_adversarial_size(size_t size, size_t max_size) {
+    if (size >= max_size) {
+        return 0;
+    }
+    return min(size * ADVERSARIAL_SIZE_STEP, max_size);
+}
+
+/*
+ * benchmark -a: every engine on every worst case input from 1 KB to max_size.
+ *  A quadratic case, say in make_delta2() or scan_text(), shows up as the
+ *  time per byte growing with the size, and fails the run. The engines must
+ *  also give the same answer as comparing the copies.
+ * There is no sampling: the sampler always checks the last window of each
+ *  copy, so it would turn end-diff away at once and the full check that is
+ *  worst on it would never be timed
+ */
+static int run_adversarial_benchmarks(size_t max_size, int reps, int warmup, const char *csv_filename,
+                                      const char *json_filename, const char *label) {
+    Logger logger(csv_filename, label);
+    vector<BenchResult> results;
+    vector<string> names;
+    names.reserve(NUM_ADVERSARIAL_ENGINES * NUM_ADVERSARIAL_INPUTS);
+    bool ok = true;
+    set_sample_budget(0);
+
+    printf("%16s, %12s, %11s, %11s, %11s, %8s, %6s, %9s\n", "engine:input", "size", "max MB/s", "median MB/s",
+           "min ns/byte", "passes", "copies", "table MB");
+    for (int e = 0; e < NUM_ADVERSARIAL_ENGINES; e++) {
+        const EngineName *engine = 0;
+        for (int j = 0; j < NUM_ENGINES; j++) {
+            if (strcmp(ADVERSARIAL_ENGINES[e], ENGINE_NAMES[j].name) == 0) {
+                engine = &ENGINE_NAMES[j];
+            }
+        }
+        for (int a = 0; a < NUM_ADVERSARIAL_INPUTS; a++) {
+            const AdversarialInput &input = ADVERSARIAL_INPUTS[a];
+            names.push_back(string(engine->name) + ":" + input.name);
+            double bound_passes = 0.0;
+            for (size_t size = ADVERSARIAL_MIN_SIZE; size != 0 && size <= max_size;
+                 size = next_adversarial_size(size, max_size)) {
+                BenchCase test = {2 * input.num_copies, input.num_copies, size / input.num_copies};
+                const BinString *bin_string = input.make(test.num_copies, test.copy_size);
+                bool big = size > ADVERSARIAL_REPS_SIZE;
+                BenchResult r = run_benchmark(*bin_string, test, *engine, big ? 1 : reps, big ? 0 : warmup);
+                r.engine = names.back().c_str();
+                double ns_per_byte = r.min_duration * 1e9 / size;
+                double passes = r.min_duration / max(read_duration(*bin_string, big ? 1 : reps), 1e-9);
+                printf("%16s, %12llu, %11.3f, %11.3f, %11.3f, %8.2f, %6d, %9.1f\n", r.engine, (unsigned long long)size,
+                       r.speed(r.min_duration), r.speed(r.median_duration), ns_per_byte, passes,
+                       r.found_num_copies, r.table_size());
+
+                // bm-raw only counts matches so its answer is not checked
+                int expected = reference_num_copies(*bin_string, test.num_pages);
+                if (!engine->raw && r.found_num_copies != expected) {
+                    cerr << "benchmark: " << r.engine << " found " << r.found_num_copies << " copies in "
+                        << size << " bytes, expected " << expected << endl;
+                    ok = false;
+                }
+                if (size >= ADVERSARIAL_BOUND_SIZE && bound_passes == 0.0) {
+                    bound_passes = passes;
+                } else if (size > ADVERSARIAL_BOUND_SIZE && passes > ADVERSARIAL_MAX_GROWTH * bound_passes) {
+                    cerr << "benchmark: " << r.engine << " took " << passes << " passes for " << size
+                        << " bytes, more than " << ADVERSARIAL_MAX_GROWTH << " times the " << bound_passes
+                        << " passes for " << ADVERSARIAL_BOUND_SIZE << " bytes" << endl;
+                    ok = false;
+                }
+                logger.log(r);
+                results.push_back(r);
+                delete bin_string;
+            }
+        }
+    }
+
+    if (json_filename && !write_json(json_filename, label, results)) {
+        ok = false;
+    }
+    return ok ? 0 : 1;
+}
+
+// Pattern lengths for benchmark -p: each end of the short pattern classes
+//  in boyer_moore.cpp, then doubling
+static const size_t PATTERN_LENGTHS[] = {1, 2, 3, 4, 5, 7, 8, 9, 12, 16, 17, 24, 32, 33, 64, 128, 256, 1024};
+static const int NUM_PATTERN_LENGTHS = sizeof(PATTERN_LENGTHS) / sizeof(PATTERN_LENGTHS[0]);
+// Kernels benchmark -p compares
+static const char *PATTERN_KERNELS[] = {"bm", "scalar", "auto"};
+static const int NUM_PATTERN_KERNELS = sizeof(PATTERN_KERNELS) / sizeof(PATTERN_KERNELS[0]);
+#define PATTERN_TEXT_SIZE (16*1024*1024)
+
+/*
+ * Time reps runs of finding every match of the patlen bytes in the middle of
+ *  text, with the search kernel already selected, after warmup untimed runs
+ */
+static BenchResult run_pattern_benchmark(const BinString &text, size_t patlen, int reps, int warmup) {
+    BenchResult result;
+    result.test.num_pages = (int)patlen;
+    result.test.num_copies = 1;
+    result.test.copy_size = text.get_len();
+    result.reps = reps;
+
+    const byte *pat = text.get_data() + text.get_len() / 2;
+    vector<size_t> tables;
+    double tb = _timer.get();
+    CompiledPattern pattern(pat, patlen, &tables, &result.search);
+    result.build_duration = _timer.get() - tb;
+
+    vector<const byte *> matches;
+    vector<double> durations;
+    for (int i = 0; i < warmup + reps; i++) {
+        double t0 = _timer.get();
+        pattern.find_all(text.get_data(), text.get_len(), patlen, &matches);
+        double t1 = _timer.get();
+        if (i >= warmup) {
+            durations.push_back(t1 - t0);
+        }
+    }
+    result.found_num_copies = (int)matches.size();
+    sort(durations.begin(), durations.end());
+    result.min_duration = durations.front();
+    result.median_duration = quantile(durations, 0.5);
+    result.p99_duration = quantile(durations, 0.99);
+    return result;
+}
+
+/*
+ * benchmark -p: every kernel in PATTERN_KERNELS on every pattern length up to
+ *  max_len. The kernels must find the same matches
+ */
+static int run_pattern_benchmarks(size_t max_len, int reps, int warmup, const char *csv_filename,
+                                  const char *json_filename, const char *label) {
+    Logger logger(csv_filename, label);
+    vector<BenchResult> results;
+    vector<string> names;
+    names.reserve(NUM_PATTERN_KERNELS * NUM_PATTERN_LENGTHS);
+    const BinString *text = make_copies(1, PATTERN_TEXT_SIZE);
+    bool ok = true;
+
+    printf("%8s, %6s, %11s, %11s, %11s, %8s\n", "kernel", "patlen", "max MB/s", "median MB/s", "p99 MB/s",
+           "matches");
+    for (int l = 0; l < NUM_PATTERN_LENGTHS && PATTERN_LENGTHS[l] <= max_len; l++) {
+        int expected = -1;
+        for (int k = 0; k < NUM_PATTERN_KERNELS; k++) {
+            for (int j = 0; j < NUM_KERNELS; j++) {
+                if (strcmp(PATTERN_KERNELS[k], KERNEL_NAMES[j].name) == 0) {
+                    set_search_kernel(KERNEL_NAMES[j].kernel);
+                }
+            }
+            BenchResult r = run_pattern_benchmark(*text, PATTERN_LENGTHS[l], reps, warmup);
+            names.push_back(string(PATTERN_KERNELS[k]));
+            r.engine = names.back().c_str();
+            printf("%8s, %6d, %11.3f, %11.3f, %11.3f, %8d\n", r.engine, r.test.num_pages,
+                   r.speed(r.min_duration), r.speed(r.median_duration), r.speed(r.p99_duration),
+                   r.found_num_copies);
+            if (k == 0) {
+                expected = r.found_num_copies;
+            } else if (r.found_num_copies != expected) {
+                cerr << "benchmark: " << r.engine << " found " << r.found_num_copies << " matches of "
+                    << r.test.num_pages << " bytes, " << PATTERN_KERNELS[0] << " found " << expected << endl;
+                ok = false;
+            }
+            logger.log(r);
+            results.push_back(r);
+        }
+    }
+    set_search_kernel(KERNEL_AUTO);
+    delete text;
+
+    if (json_filename && !write_json(json_filename, label, results)) {
+        ok = false;
+    }
+    return ok ? 0 : 1;
+}
+
+static void usage() {
+    cerr << "usage: benchmark [-e bm-raw|bm|hash|single|anchor|page|period|run] [-k auto|bm|scalar|sse2|avx2]"
+        << " [-m two-way size] [-r reps] [-w warmup] [-t threads] [-s budget]"
+        << " [-o csv file] [-j json file] [-l label] [num_pages num_copies copy_size]" << endl;
+    cerr << "       benchmark -a max_size [-m two-way size] [-r reps] [-w warmup] [-o csv file] [-j json file]"
+        << " [-l label]" << endl;
+    cerr << "       benchmark -p max_len [-r reps] [-w warmup] [-o csv file] [-j json file] [-l label]"
+        << endl;
+    cerr << "       benchmark -f spool_file [-i cached|cold|direct] [-r reps] [-w warmup] [-o csv file]"
+        << " [-j json file] [-l label] num_pages" << endl;
+}
+
+/*
+ * benchmark -f: the speed of each FileMethod and how close it gets to the
+ *  speed of just reading the file
+ */
+static int run_file_benchmarks(const char *path, const vector<const char *> &args, const char *read_mode,
+                               int reps, int warmup, const char *csv_filename, const char *json_filename,
+                               const char *label) {
+    bool cold = strcmp(read_mode, "cold") == 0 || strcmp(read_mode, "direct") == 0;
+    bool direct = strcmp(read_mode, "direct") == 0;
+    if (args.size() != 1 || reps < 1 || warmup < 0 || (!cold && strcmp(read_mode, "cached") != 0)) {
+        usage();
+        return 1;
+    }
+    int num_pages = atoi(args[0]);
+
+    Logger logger(csv_filename, label);
+    vector<BenchResult> results;
+    printf("%6s, %6s, %8s, %11s, %11s, %11s, %9s, %6s\n", "method", "pages", "size MB", "max MB/s",
+           "median MB/s", "p99 MB/s", "% of read", "copies");
+    for (int method = 0; method < NUM_FILE_METHODS; method++) {
+        BenchResult r = run_file_benchmark(path, num_pages, (FileMethod)method, cold, direct, reps, warmup);
+        const BenchResult &read = results.empty() ? r : results[0];
+        double read_speed = read.speed(read.median_duration);
+        printf("%6s, %6d, %8.1f, %11.3f, %11.3f, %11.3f, %8.1f%%, %6d\n", r.engine, num_pages, r.total_size(),
+               r.speed(r.min_duration), r.speed(r.median_duration), r.speed(r.p99_duration),
+               100.0 * r.speed(r.median_duration) / read_speed, r.found_num_copies);
+        logger.log(r);
+        results.push_back(r);
+    }
+    if (results[0].test.copy_size == 0) {
+        cerr << "benchmark: could not read " << path << endl;
+        return 1;
+    }
+    if (json_filename && !write_json(json_filename, label, results)) {
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+
+    const EngineName *engine = &ENGINE_NAMES[0];
+    const KernelName *kernel = &KERNEL_NAMES[0];
+    int reps = 10;
+    int warmup = 2;
+    const char *csv_filename = "inline.copies.csv";
+    const char *json_filename = 0;
+    const char *label = "";
+    const char *spool_filename = 0;
+    const char *read_mode = "cached";
+    size_t adversarial_size = 0;
+    size_t max_patlen = 0;
+    vector<const char *> args;
+
+    for (int i = 1; i < argc; i++) {
+        if (argv[i][0] != '-' || argv[i][1] == 0 || argv[i][2] != 0) {
+            args.push_back(argv[i]);
+            continue;
+        }
+        if (i + 1 >= argc) {
+            usage();
+            return 1;
+        }
+        const char *value = argv[++i];
+        switch (argv[i - 1][1]) {
+        case 'e':
+            engine = 0;
+            for (int j = 0; j < NUM_ENGINES; j++) {
+                if (strcmp(value, ENGINE_NAMES[j].name) == 0) {
+                    engine = &ENGINE_NAMES[j];
+                }
+            }
+            if (!engine) {
+                cerr << "Unknown engine " << value << endl;
+                return 1;
+            }
+            break;
+        case 'r':
+            reps = atoi(value);
+            break;
+        case 'w':
+            warmup = atoi(value);
+            break;
+        case 't':
+            set_search_threads(atoi(value));
+            break;
+        case 's':
+            set_sample_budget(atoi(value));
+            break;
+        case 'o':
+            csv_filename = value;
+            break;
+        case 'j':
+            json_filename = value;
+            break;
+        case 'l':
+            label = value;
+            break;
+        case 'f':
+            spool_filename = value;
+            break;
+        case 'i':
+            read_mode = value;
+            break;
+        case 'k':
+            kernel = 0;
+            for (int j = 0; j < NUM_KERNELS; j++) {
+                if (strcmp(value, KERNEL_NAMES[j].name) == 0) {
+                    kernel = &KERNEL_NAMES[j];
+                }
+            }
+            if (!kernel) {
+                cerr << "Unknown kernel " << value << endl;
+                return 1;
+            }
+            break;
+        case 'm':
+            set_two_way_min_patlen(parse_size(value));
+            break;
+        case 'p':
+            max_patlen = (size_t)atol(value);
+            if (max_patlen < 1) {
+                usage();
+                return 1;
+            }
+            break;
+        case 'a':
+            adversarial_size = parse_size(value);
+            if (adversarial_size < ADVERSARIAL_MIN_SIZE) {
+                usage();
+                return 1;
+            }
+            break;
+        default:
+            usage();
+            return 1;
+        }
+    }
+
+    if (adversarial_size > 0) {
+        if (!args.empty() || reps < 1 || warmup < 0) {
+            usage();
+            return 1;
+        }
+        return run_adversarial_benchmarks(adversarial_size, reps, warmup, csv_filename, json_filename, label);
+    }
+    set_search_kernel(kernel->kernel);
+
+    if (max_patlen > 0) {
+        if (!args.empty() || reps < 1 || warmup < 0) {
+            usage();
+            return 1;
+        }
+        return run_pattern_benchmarks(max_patlen, reps, warmup, csv_filename, json_filename, label);
+    }
+    if (spool_filename) {
+        return run_file_benchmarks(spool_filename, args, read_mode, reps, warmup, csv_filename, json_filename,
+                                   label);
+    }
+
+    vector<BenchCase> cases;
+    if (args.size() == 3) {
+        BenchCase test = {atoi(args[0]), atoi(args[1]), (size_t)atol(args[2])};
+        if (test.num_copies < 2 || test.num_pages < test.num_copies || test.num_pages % test.num_copies != 0) {
+            cerr << "num_pages must be a multiple of num_copies and num_copies must be at least 2" << endl;
+            return 1;
+        }
+        cases.push_back(test);
+    } else if (args.empty()) {
+        cases.assign(STANDARD_CASES, STANDARD_CASES + NUM_STANDARD_CASES);
+    } else {
+        usage();
+        return 1;
+    }
+    if (reps < 1 || warmup < 0) {
+        usage();
+        return 1;
+    }
+
+    Logger logger(csv_filename, label);
+    vector<BenchResult> results;
+    bool ok = true;
+
+    printf("%6s, %6s, %6s, %9s, %8s, %11s, %11s, %11s, %8s, %9s\n", "engine", "pages", "copies", "copy_size",
+           "size MB", "max MB/s", "median MB/s", "p99 MB/s", "build s", "table MB");
+    for (unsigned int i = 0; i < cases.size(); i++) {
+        BenchResult r = run_benchmark(cases[i], *engine, reps, warmup);
+        printf("%6s, %6d, %6d, %9llu, %8.1f, %11.3f, %11.3f, %11.3f, %8.4f, %9.1f\n", r.engine, r.test.num_pages,
+               r.test.num_copies, (unsigned long long)r.test.copy_size, r.total_size(), r.speed(r.min_duration),
+               r.speed(r.median_duration), r.speed(r.p99_duration), r.build_duration, r.table_size());
+#ifdef BM_STATS
+        const SearchStats &search = r.search;
+        printf("%6s  %llu patterns, %.3f comparisons/byte, average shift %.1f, delta1/delta2 wins %llu/%llu, "
+               "build %.6fs, scan %.6fs\n", "", search.num_patterns,
+               (double)search.comparisons / (double)(r.test.num_copies * r.test.copy_size),
+               search.get_average_shift(), search.delta1_wins, search.delta2_wins, search.build_seconds,
+               search.scan_seconds);
+#endif
+        if (r.found_num_copies != r.test.num_copies) {
+            cerr << "benchmark: found " << r.found_num_copies << " copies, expected " << r.test.num_copies << endl;
+            ok = false;
+        }
+        logger.log(r);
+        results.push_back(r);
+    }
+
+    if (json_filename && !write_json(json_filename, label, results)) {
+        ok = false;
+    }
+    return ok ? 0 : 1;
+}
@@ -1,172 +1,703 @@
-#include <list>
-#include <stdlib.h>
-#include "boyer_moore.h"
-
-using namespace std;
-
-#ifdef  _WIN64
-typedef  __int64    ssize_t;
-#elif defined(WIN32)
-typedef _W64  int   ssize_t;
-#endif
-
-#define ALPHABET_LEN 255
-#define NOT_FOUND patlen
-#define max(a, b) ((a < b) ? b : a)
- 
-// delta1 table: delta1[c] contains the distance between the last
-// character of pat and the rightmost occurence of c in pat.
-// If c does not occur in pat, then delta1[c] = patlen.
-// If c is at string[i] and c != pat[patlen-1], we can
-// safely shift i over by delta1[c], which is the minimum distance
-// needed to shift pat forward to get string[i] lined up 
-// with some character in pat.
-// this algorithm runs in alphabet_len+patlen time.
-void make_delta1(size_t *delta1, const byte *pat, size_t patlen) {
-    size_t i;
-    for (i = 0; i < ALPHABET_LEN; i++) {
-        delta1[i] = NOT_FOUND;
-    }
-    for (i = 0; i < patlen - 1; i++) {
-        delta1[pat[i]] = patlen - 1 - i;
-    }
-}
- 
-// true if the suffix of word starting from word[pos] is a prefix 
-// of word
-int is_prefix(const byte *word, size_t wordlen, size_t pos) {
-    size_t i;
-    size_t suffixlen = wordlen - pos;
-    // could also use the strncmp() library function here
-    for (i = 0; i < suffixlen; i++) {
-        if (word[i] != word[pos+i]) {
-            return 0;
-        }
-    }
-    return 1;
-}
- 
-// length of the longest suffix of word ending on word[pos].
-// suffix_length("dddbcabc", 8, 4) = 2
-size_t suffix_length(const byte *word, size_t wordlen, size_t pos) {
-    size_t i;
-    // increment suffix length i to the first mismatch or beginning
-    // of the word
-    for (i = 0; (word[pos-i] == word[wordlen-1-i]) && (i < pos); i++)
-        ;;;
-    return i;
-}
- 
-// delta2 table: given a mismatch at pat[pos], we want to align 
-// with the next possible full match could be based on what we
-// know about pat[pos+1] to pat[patlen-1].
-//
-// In case 1:
-// pat[pos+1] to pat[patlen-1] does not occur elsewhere in pat,
-// the next plausible match starts at or after the mismatch.
-// If, within the substring pat[pos+1 .. patlen-1], lies a prefix
-// of pat, the next plausible match is here (if there are multiple
-// prefixes in the substring, pick the longest). Otherwise, the
-// next plausible match starts past the character aligned with 
-// pat[patlen-1].
-// 
-// In case 2:
-// pat[pos+1] to pat[patlen-1] does occur elsewhere in pat. The
-// mismatch tells us that we are not looking at the end of a match.
-// We may, however, be looking at the middle of a match.
-// 
-// The first loop, which takes care of case 1, is analogous to
-// the KMP table, adapted for a 'backwards' scan order with the
-// additional restriction that the substrings it considers as 
-// potential prefixes are all suffixes. In the worst case scenario
-// pat consists of the same letter repeated, so every suffix is
-// a prefix. This loop alone is not sufficient, however:
-// Suppose that pat is "ABYXCDEYX", and text is ".....ABYXCDEYX".
-// We will match X, Y, and find B != E. There is no prefix of pat
-// in the suffix "YX", so the first loop tells us to skip forward
-// by 9 characters.
-// Although superficially similar to the KMP table, the KMP table
-// relies on information about the beginning of the partial match
-// that the BM algorithm does not have.
-//
-// The second loop addresses case 2. Since suffix_length may not be
-// unique, we want to take the minimum value, which will tell us
-// how far away the closest potential match is.
-void make_delta2(size_t *delta2, const byte *pat, size_t patlen) {
-    ssize_t p;
-    size_t last_prefix_index = patlen-1;
- 
-    // first loop
-    for (p = patlen-1; p >= 0; p--) {
-        if (is_prefix(pat, patlen, p+1)) {
-            last_prefix_index = p+1;
-        }
-        delta2[p] = last_prefix_index + (patlen-1 - p);
-    }
- 
-    // second loop
-    for (p = 0; p < (ssize_t)(patlen-1); p++) {
-        size_t slen = suffix_length(pat, patlen, p);
-        if (pat[p - slen] != pat[patlen-1 - slen]) {
-            delta2[patlen-1 - slen] = patlen-1 - p + slen;
-        }
-    }
-}
-
-static const byte *scan_text(const byte *text, size_t textlen, const byte *pat, size_t patlen,
-                        const size_t *delta1,  const size_t *delta2) {
-    size_t i = patlen - 1;
-    while (i < textlen) {
-        ssize_t j = patlen-1;
-        while (j >= 0 && (text[i] == pat[j])) {
-            --i;
-            --j;
-        }
-        if (j < 0) {
-            return text + i + 1;
-        }
- 
-        i += max(delta1[text[i]], delta2[j]);
-    }
-    return NULL;
-}
-
-const byte *boyer_moore(const byte *text, size_t textlen, const byte *pat, size_t patlen) {
- 
-    size_t delta1[ALPHABET_LEN];
-    size_t *delta2 = (size_t *)malloc(patlen * sizeof(size_t));
-    make_delta1(delta1, pat, patlen);
-    make_delta2(delta2, pat, patlen);
-
-    const byte *result = scan_text(text, textlen, pat, patlen, delta1, delta2); 
- 
-    free(delta2);
-    return result;
-}
-
-vector<const byte *> boyer_moore_all(const byte *text, size_t textlen, const byte *pat, size_t patlen, size_t min_gap) {
-  
-    size_t delta1[ALPHABET_LEN];
-    size_t *delta2 = (size_t *)malloc(patlen * sizeof(size_t));
-    make_delta1(delta1, pat, patlen);
-    make_delta2(delta2, pat, patlen);
-
-    list<const byte *> matches;
-
-    const byte *end = text + textlen;
-    const byte *p = text;
-    while (p + patlen <= end) {
-        const byte *m = scan_text(p, end - p, pat, patlen, delta1, delta2);
-        if (!m) {
-            break;
-        }
-        matches.push_back(m);
-        // Skip to end of match, always skip at least min_grap
-        p = max(p + min_gap, m + patlen); 
-    }
- 
-    free(delta2);
-    return vector<const byte *>(matches.begin(), matches.end());
-}
-
-
+#include <list>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <stdlib.h>
+#include <string.h>
+#include "boyer_moore.h"
+#include "search_simd.h"
+#include "period.h"
+#include "Timer.h"
+
+using namespace std;
+
+#ifdef  _WIN64
+typedef  __int64    ssize_t;
+#elif defined(WIN32)
+typedef _W64  int   ssize_t;
+#endif
+
+#define NOT_FOUND patlen
+#define max(a, b) ((a < b) ? b : a)
+ 
+// delta1 table: delta1[c] contains the distance between the last
+// character of pat and the rightmost occurence of c in pat.
+// If c does not occur in pat, then delta1[c] = patlen.
+// If c is at string[i] and c != pat[patlen-1], we can
+// safely shift i over by delta1[c], which is the minimum distance
+// needed to shift pat forward to get string[i] lined up 
+// with some character in pat.
+// this algorithm runs in alphabet_len+patlen time.
+void make_delta1(size_t *delta1, const byte *pat, size_t patlen) {
+    size_t i;
+    for (i = 0; i < ALPHABET_LEN; i++) {
+        delta1[i] = NOT_FOUND;
+    }
+    for (i = 0; i < patlen - 1; i++) {
+        delta1[pat[i]] = patlen - 1 - i;
+    }
+}
+ 
+// suff[i] = length of the longest substring of pat ending at pat[i] that is
+// also a suffix of pat. Computed in linear time by reusing the match found
+// for an earlier position the same way the Z algorithm does.
+static void suffixes(const byte *pat, size_t patlen, size_t *suff) {
+    ssize_t m = (ssize_t)patlen;
+    ssize_t f = 0;
+    ssize_t g = m - 1;
+    suff[m - 1] = m;
+    for (ssize_t i = m - 2; i >= 0; i--) {
+        if (i > g && (ssize_t)suff[i + m - 1 - f] < i - g) {
+            suff[i] = suff[i + m - 1 - f];
+        } else {
+            if (i < g) {
+                g = i;
+            }
+            f = i;
+            while (g >= 0 && pat[g] == pat[g + m - 1 - f]) {
+                g--;
+            }
+            suff[i] = f - g;
+        }
+    }
+}
+ 
+// delta2 table: given a mismatch at pat[pos], we want to align 
+// with the next possible full match could be based on what we
+// know about pat[pos+1] to pat[patlen-1].
+//
+// In case 1:
+// pat[pos+1] to pat[patlen-1] does not occur elsewhere in pat,
+// the next plausible match starts at or after the mismatch.
+// If, within the substring pat[pos+1 .. patlen-1], lies a prefix
+// of pat, the next plausible match is here (if there are multiple
+// prefixes in the substring, pick the longest). Otherwise, the
+// next plausible match starts past the character aligned with 
+// pat[patlen-1].
+// 
+// In case 2:
+// pat[pos+1] to pat[patlen-1] does occur elsewhere in pat. The
+// mismatch tells us that we are not looking at the end of a match.
+// We may, however, be looking at the middle of a match.
+// 
+// The first loop, which takes care of case 1, is analogous to
+// the KMP table, adapted for a 'backwards' scan order with the
+// additional restriction that the substrings it considers as 
+// potential prefixes are all suffixes. In the worst case scenario
+// pat consists of the same letter repeated, so every suffix is
+// a prefix. This loop alone is not sufficient, however:
+// Suppose that pat is "ABYXCDEYX", and text is ".....ABYXCDEYX".
+// We will match X, Y, and find B != E. There is no prefix of pat
+// in the suffix "YX", so the first loop tells us to skip forward
+// by 9 characters.
+// Although superficially similar to the KMP table, the KMP table
+// relies on information about the beginning of the partial match
+// that the BM algorithm does not have.
+//
+// Both cases are computed from the suff[] table in linear time.
+// shift[j] is how far the pattern can move after a mismatch at pat[j]:
+// Case 2 is a suffix pat[j+1..] that reoccurs at pat[i-suff[i]+1..i] and is
+// preceded by a different character, giving shift = patlen-1-i.
+// Case 1 is the longest suffix of pat[j+1..] that is a prefix of pat, giving
+// shift = patlen - prefix length.
+// The scan indexes delta2 from the mismatched text character rather than
+// from the end of the pattern, hence delta2[j] = shift[j] + (patlen-1 - j).
+// This replaces a construction that was quadratic for patterns such as
+// all blanks where every suffix is a prefix.
+// suff is scratch space for patlen entries
+static void make_delta2(size_t *delta2, size_t *suff, const byte *pat, size_t patlen) {
+    ssize_t m = (ssize_t)patlen;
+    suffixes(pat, patlen, suff);
+
+    // delta2 holds the shifts until the last loop
+    for (ssize_t j = 0; j < m; j++) {
+        delta2[j] = m;
+    }
+    // case 1
+    ssize_t j = 0;
+    for (ssize_t i = m - 1; i >= 0; i--) {
+        if ((ssize_t)suff[i] == i + 1) {
+            for (; j < m - 1 - i; j++) {
+                if ((ssize_t)delta2[j] == m) {
+                    delta2[j] = m - 1 - i;
+                }
+            }
+        }
+    }
+    // case 2
+    for (ssize_t i = 0; i <= m - 2; i++) {
+        delta2[m - 1 - suff[i]] = m - 1 - i;
+    }
+
+    for (j = 0; j < m; j++) {
+        delta2[j] += m - 1 - j;
+    }
+}
+
+void make_delta2(size_t *delta2, const byte *pat, size_t patlen) {
+    vector<size_t> suff(patlen);
+    make_delta2(delta2, &suff[0], pat, patlen);
+}
+
+static const byte *scan_text(const byte *text, size_t textlen, const byte *pat, size_t patlen,
+                        const size_t *delta1,  const size_t *delta2, SearchStats *stats) {
+#ifdef BM_STATS
+    SearchStats counts;
+#endif
+    const byte *found = NULL;
+    size_t i = patlen - 1;
+    while (i < textlen) {
+        ssize_t j = patlen-1;
+        while (j >= 0 && (text[i] == pat[j])) {
+            --i;
+            --j;
+        }
+#ifdef BM_STATS
+        // The bytes that matched and the one that did not
+        size_t num_matched = patlen - 1 - j;
+        counts.comparisons += j < 0 ? num_matched : num_matched + 1;
+#endif
+        if (j < 0) {
+            found = text + i + 1;
+            break;
+        }
+ 
+#ifdef BM_STATS
+        // i has moved back over the bytes that matched, so the pattern moves
+        //  on by less than i does
+        size_t shift = max(delta1[text[i]], delta2[j]);
+        counts.shifts++;
+        counts.shift_bytes += shift - num_matched;
+        if (delta1[text[i]] > delta2[j]) {
+            counts.delta1_wins++;
+        } else {
+            counts.delta2_wins++;
+        }
+#endif
+        i += max(delta1[text[i]], delta2[j]);
+    }
+#ifdef BM_STATS
+    if (stats) {
+        // Each comparison reads a text and a pattern byte, each shift a
+        //  delta1 and a delta2 entry
+        counts.bytes_touched = 2 * counts.comparisons + 2 * sizeof(size_t) * counts.shifts;
+        stats->add(counts);
+    }
+#else
+    (void)stats;
+#endif
+    return found;
+}
+
+/*
+ * Kernels for short patterns
+ *
+ * scan_text() looks up both tables and loops over the pattern for every
+ *  shift, and the shift can be no longer than the pattern. For short
+ *  patterns that overhead is most of the time, so they get kernels of their
+ *  own, specialised at compile time for the pattern length class:
+ *  1 to SHORT_MAX_PATLEN bytes: memchr() for the first byte, then the whole
+ *   pattern compared as one word. No tables.
+ *  Up to MEDIUM_MAX_PATLEN bytes: Horspool, which shifts by delta1 of the
+ *   text byte under the end of the pattern and compares the pattern as an
+ *   unrolled run of words. No delta2.
+ *  Longer: scan_text().
+ * Each is linear in the text as the compare is a fixed number of words.
+ * The SIMD kernels, where the CPU has them, are used instead of the first
+ *  two classes, see get_simd_search().
+ */
+#define SHORT_MAX_PATLEN 8
+#define MEDIUM_MAX_PATLEN 32
+
+typedef unsigned long long word_t;
+
+// The N bytes at p as a word, for comparing with another. memcpy() of a
+//  constant size compiles to loads, with no alignment requirement
+template <size_t N>
+static inline word_t load_word(const byte *p) {
+    word_t w = 0;
+    memcpy(&w, p, N);
+    return w;
+}
+
+// memchr() for the first byte, then one word compare. N is the pattern
+//  length. It has the scan_text_t arguments but needs no tables
+template <size_t N>
+static const byte *scan_short(const byte *text, size_t textlen, const byte *pat, size_t,
+                              const size_t *, const size_t *, SearchStats *) {
+    if (textlen < N) {
+        return NULL;
+    }
+    const word_t want = load_word<N>(pat);
+    const byte *last = text + textlen - N;     // last place a match can start
+    for (const byte *p = text; p <= last; p++) {
+        p = (const byte *)memchr(p, pat[0], last - p + 1);
+        if (!p) {
+            break;
+        }
+        if (N == 1 || load_word<N>(p) == want) {
+            return p;
+        }
+    }
+    return NULL;
+}
+
+// The pattern as WORDS words, the last one ending at the end of the pattern
+//  so that it overlaps the one before unless patlen is a multiple of 8
+template <int WORDS>
+struct PatternWords {
+    word_t words[WORDS];
+    size_t last_ofs;
+
+    PatternWords(const byte *pat, size_t patlen): last_ofs(patlen - 8) {
+        for (int k = 0; k < WORDS - 1; k++) {
+            words[k] = load_word<8>(pat + 8 * k);
+        }
+        words[WORDS - 1] = load_word<8>(pat + last_ofs);
+    }
+    bool matches(const byte *p) const {
+        // WORDS is a constant so this is unrolled
+        for (int k = 0; k < WORDS - 1; k++) {
+            if (load_word<8>(p + 8 * k) != words[k]) {
+                return false;
+            }
+        }
+        return load_word<8>(p + last_ofs) == words[WORDS - 1];
+    }
+};
+
+// Horspool for 8*(WORDS-1) < patlen <= 8*WORDS
+template <int WORDS>
+static const byte *scan_horspool(const byte *text, size_t textlen, const byte *pat, size_t patlen,
+                                 const size_t *delta1, const size_t *, SearchStats *) {
+    if (textlen < patlen) {
+        return NULL;
+    }
+    const PatternWords<WORDS> words(pat, patlen);
+    const byte end = pat[patlen - 1];
+    const size_t last = textlen - patlen;      // last place a match can start
+    size_t i = 0;
+    while (i <= last) {
+        byte c = text[i + patlen - 1];
+        if (c == end && words.matches(text + i)) {
+            return text + i;
+        }
+        // delta1 is the Horspool shift: from the end of the pattern to the
+        //  rightmost c before it
+        i += delta1[c];
+    }
+    return NULL;
+}
+
+static const scan_text_t SHORT_SCANS[SHORT_MAX_PATLEN + 1] = {
+    scan_text, scan_short<1>, scan_short<2>, scan_short<3>, scan_short<4>,
+    scan_short<5>, scan_short<6>, scan_short<7>, scan_short<8>
+};
+
+static const scan_text_t MEDIUM_SCANS[MEDIUM_MAX_PATLEN / 8 + 1] = {
+    scan_text, scan_text, scan_horspool<2>, scan_horspool<3>, scan_horspool<4>
+};
+
+// The scalar kernel for a pattern of length patlen
+static scan_text_t get_scan(size_t patlen) {
+    if (get_search_kernel() == KERNEL_BOYER_MOORE || patlen > MEDIUM_MAX_PATLEN) {
+        return scan_text;
+    }
+    if (patlen <= SHORT_MAX_PATLEN) {
+        return SHORT_SCANS[patlen];
+    }
+    return MEDIUM_SCANS[(patlen + 7) / 8];
+}
+
+/*
+ * Two-Way (Crochemore-Perrin) for very long patterns
+ *
+ * delta2 takes 8 bytes per pattern byte, and as many again while it is
+ *  built, so find_repeats() on two copies of a 4 GB spool would want 32 GB
+ *  for its 2 GB pattern. Two-Way needs only a critical factorization
+ *  pat = pat[0..l) pat[l..patlen), which period.h finds in linear time and
+ *  constant memory, and delta1, whose size does not depend on the pattern.
+ *  Each window compares the right part left to right and on a mismatch
+ *  shifts past it. Once the right part matches, the left part is compared
+ *  and on a mismatch the window moves on by period.
+ * If period is the period of the whole pattern the first patlen - period
+ *  bytes of the next window are already known to match, and are not
+ *  compared again. That keeps the search linear: each text byte is
+ *  compared at most twice.
+ */
+static size_t _two_way_min_patlen = TWO_WAY_MIN_PATLEN;
+
+void set_two_way_min_patlen(size_t min_patlen) {
+    _two_way_min_patlen = min_patlen;
+}
+
+size_t get_two_way_min_patlen() {
+    return _two_way_min_patlen;
+}
+
+static bool use_two_way(size_t patlen) {
+    return _two_way_min_patlen > 0 && patlen >= _two_way_min_patlen;
+}
+
+// delta1 is only the 256 entry bad character table: the shift to the
+//  rightmost occurrence of the byte under the end of the window. It skips
+//  most windows without comparing them, as in Boyer-Moore. BM_STATS counts
+//  its shifts as delta1 wins and the Two-Way shifts as delta2 wins
+static const byte *scan_two_way(const byte *text, size_t textlen, const byte *pat, size_t patlen,
+                                const size_t *delta1, size_t critical_pos, size_t period, bool periodic,
+                                SearchStats *stats) {
+#ifdef BM_STATS
+    SearchStats counts;
+#endif
+    const byte *found = NULL;
+    const byte end = pat[patlen - 1];
+    size_t memory = 0;          // pat[0..memory) is known to match the window
+    size_t j = 0;
+    while (j + patlen <= textlen) {
+        const byte *window = text + j;
+        byte c = window[patlen - 1];
+#ifdef BM_STATS
+        counts.comparisons++;
+#endif
+        size_t shift;
+        if (c != end) {
+            shift = delta1[c];
+            // The last period of the window did not match, so neither can
+            //  any window that overlaps it by a whole period
+            if (memory && shift < period) {
+                shift = patlen - period;
+            }
+            memory = 0;
+#ifdef BM_STATS
+            counts.shifts++;
+            counts.delta1_wins++;
+            counts.shift_bytes += shift;
+#endif
+            j += shift;
+            continue;
+        }
+        // The last byte matched, so compare the right part up to it
+        size_t i = max(critical_pos, memory);
+        size_t num_matched = i < patlen - 1 && window[i] == pat[i]
+            ? common_prefix(pat + i, window + i, patlen - 1 - i) : 0;
+#ifdef BM_STATS
+        counts.comparisons += i + num_matched < patlen - 1 ? num_matched + 1 : num_matched;
+#endif
+        i += num_matched;
+        if (i < patlen - 1) {
+            shift = i - critical_pos + 1;
+            memory = 0;
+        } else {
+#ifdef BM_STATS
+            counts.comparisons += critical_pos > memory ? critical_pos - memory : 0;
+#endif
+            if (memory >= critical_pos
+                || memcmp(pat + memory, window + memory, critical_pos - memory) == 0) {
+                found = window;
+                break;
+            }
+            shift = period;
+            memory = periodic ? patlen - period : 0;
+        }
+#ifdef BM_STATS
+        counts.shifts++;
+        counts.delta2_wins++;
+        counts.shift_bytes += shift;
+#endif
+        j += shift;
+    }
+#ifdef BM_STATS
+    if (stats) {
+        // Each comparison reads a text and a pattern byte, each shift by
+        //  delta1 an entry of it
+        counts.bytes_touched = 2 * counts.comparisons + sizeof(size_t) * counts.delta1_wins;
+        stats->add(counts);
+    }
+#else
+    (void)stats;
+#endif
+    return found;
+}
+
+void SearchStats::add(const SearchStats &other) {
+    num_patterns += other.num_patterns;
+    comparisons += other.comparisons;
+    shifts += other.shifts;
+    shift_bytes += other.shift_bytes;
+    delta1_wins += other.delta1_wins;
+    delta2_wins += other.delta2_wins;
+    bytes_touched += other.bytes_touched;
+    build_seconds += other.build_seconds;
+    scan_seconds += other.scan_seconds;
+    table_bytes = max(table_bytes, other.table_bytes);
+}
+
+CompiledPattern::CompiledPattern(const byte *pat, size_t patlen):
+    _pat(pat),
+    _patlen(patlen),
+    _simd(get_simd_search(patlen)),
+    _scan(get_scan(patlen)),
+    _two_way(!_simd && use_two_way(patlen)),
+    _critical_pos(0),
+    _period(0),
+    _periodic(false),
+    _delta2(0),
+    _owns_delta2(true),
+    _stats(0)
+{
+    // The SIMD kernels do not need the delta tables, Two-Way and the short
+    //  ones not all
+    bool use_tables = !_simd && !_two_way;
+    bool need_delta2 = use_tables && _scan == scan_text;
+    if (_two_way) {
+        make_two_way(0);
+    }
+    if (_two_way || need_delta2 || (use_tables && patlen > SHORT_MAX_PATLEN)) {
+        make_delta1(_delta1, pat, patlen);
+    }
+    if (need_delta2) {
+        _delta2 = (size_t *)malloc(patlen * sizeof(size_t));
+        make_delta2(_delta2, pat, patlen);
+    }
+}
+
+CompiledPattern::CompiledPattern(const byte *pat, size_t patlen, vector<size_t> *tables, SearchStats *stats):
+    _pat(pat),
+    _patlen(patlen),
+    _simd(get_simd_search(patlen)),
+    _scan(get_scan(patlen)),
+    _two_way(!_simd && use_two_way(patlen)),
+    _critical_pos(0),
+    _period(0),
+    _periodic(false),
+    _delta2(0),
+    _owns_delta2(false),
+    _stats(stats)
+{
+#ifdef BM_STATS
+    Timer timer;
+#endif
+    bool use_tables = !_simd && !_two_way;
+    bool need_delta2 = use_tables && _scan == scan_text;
+    bool need_delta1 = _two_way || need_delta2 || (use_tables && patlen > SHORT_MAX_PATLEN);
+    if (_two_way) {
+        make_two_way(_stats);
+    }
+    if (need_delta1) {
+        make_delta1(_delta1, pat, patlen);
+    }
+    if (need_delta2) {
+        // delta2 followed by the suffixes scratch
+        tables->resize(2 * patlen);
+        _delta2 = &(*tables)[0];
+        make_delta2(_delta2, _delta2 + patlen, pat, patlen);
+    }
+#ifdef BM_STATS
+    if (_stats) {
+        _stats->num_patterns++;
+        _stats->build_seconds += timer.get();
+        // delta1, then delta2 and the suffixes scratch, each from the pattern
+        if (need_delta1) {
+            _stats->bytes_touched += ALPHABET_LEN * sizeof(size_t) + patlen;
+        }
+        if (need_delta2) {
+            _stats->bytes_touched += 2 * patlen * sizeof(size_t) + patlen;
+        }
+    }
+#endif
+    if (_stats) {
+        // delta1, then delta2 and the suffixes scratch
+        size_t table_bytes = (need_delta1 ? sizeof(_delta1) : 0)
+            + (need_delta2 ? 2 * patlen * sizeof(size_t) : 0);
+        _stats->table_bytes = max(_stats->table_bytes, table_bytes);
+    }
+}
+
+void CompiledPattern::make_two_way(SearchStats *stats) {
+    ScanStats scan;
+    _critical_pos = critical_factorization(_pat, _patlen, &_period, &scan);
+    // The right part has period _period. If the left part is a suffix of
+    //  its first period the whole pattern does
+    _periodic = memcmp(_pat, _pat + _period, _critical_pos) == 0;
+    if (!_periodic) {
+        // No shift this long can skip a match
+        _period = max(_critical_pos, _patlen - _critical_pos) + 1;
+    }
+#ifdef BM_STATS
+    if (stats) {
+        stats->bytes_touched += scan.bytes_read + 2 * _critical_pos;
+    }
+#else
+    (void)stats;
+#endif
+}
+
+CompiledPattern::~CompiledPattern() {
+    if (_owns_delta2) {
+        free(_delta2);
+    }
+}
+
+const byte *CompiledPattern::find(const byte *text, size_t textlen) const {
+#ifdef BM_STATS
+    if (_stats) {
+        Timer timer;
+        const byte *found = search(text, textlen, _stats);
+        _stats->scan_seconds += timer.get();
+        return found;
+    }
+#endif
+    return search(text, textlen, 0);
+}
+
+const byte *CompiledPattern::search(const byte *text, size_t textlen, SearchStats *stats) const {
+    if (_simd) {
+        return _simd(text, textlen, _pat, _patlen);
+    }
+    if (_two_way) {
+        return scan_two_way(text, textlen, _pat, _patlen, _delta1, _critical_pos, _period, _periodic, stats);
+    }
+    return _scan(text, textlen, _pat, _patlen, _delta1, _delta2, stats);
+}
+
+vector<const byte *> CompiledPattern::find_all(const byte *text, size_t textlen, size_t min_gap) const {
+    vector<const byte *> matches;
+    find_all(text, textlen, min_gap, &matches);
+    return matches;
+}
+
+void CompiledPattern::find_all(const byte *text, size_t textlen, size_t min_gap, vector<const byte *> *matches) const {
+
+    matches->clear();
+
+    const byte *end = text + textlen;
+    const byte *p = text;
+    while (p + _patlen <= end) {
+        const byte *m = find(p, end - p);
+        if (!m) {
+            break;
+        }
+        matches->push_back(m);
+        // Skip to end of match, always skip at least min_grap
+        p = max(p + min_gap, m + _patlen); 
+    }
+}
+
+const byte *boyer_moore(const byte *text, size_t textlen, const byte *pat, size_t patlen) {
+    return CompiledPattern(pat, patlen).find(text, textlen);
+}
+
+vector<const byte *> boyer_moore_all(const byte *text, size_t textlen, const byte *pat, size_t patlen, size_t min_gap) {
+    return CompiledPattern(pat, patlen).find_all(text, textlen, min_gap);
+}
+
+/*
+ * Multithreaded boyer_moore_all()
+ *
+ * The range of possible match starts is split into chunks. Each chunk is
+ *  scanned by a worker thread as far as patlen-1 bytes past its end so that
+ *  matches straddling chunk boundaries are found. Workers follow the same
+ *  greedy non-overlapping chain as boyer_moore_all() but starting from the
+ *  start of their chunk.
+ * The serial chain depends on where the previous chunk's chain left off, so
+ *  the merge replays it using the workers' results:
+ *  Each worker search from s_i found m_i, the first match at or after s_i.
+ *  So for any search position p with s_i <= p <= m_i the first match at or
+ *  after p is m_i. Only when p falls after m_i and before s_(i+1) is there a
+ *  gap the workers did not scan, and that gap is scanned during the merge.
+ *  In the common case the chains line up and the merge is just a copy.
+ * The compiled pattern is shared read-only by all threads.
+ */
+
+#define MIN_CHUNK_SIZE (1024 * 1024)
+#define CHUNKS_PER_THREAD 4
+
+struct ChunkScan {
+    const byte *start;                  // first match start covered by chunk
+    const byte *end;                    // one past last match start covered by chunk
+    std::vector<const byte *> searches; // search positions, increasing
+    std::vector<const byte *> matches;  // match found from each search or NULL
+};
+
+static void scan_chunk(ChunkScan *chunk, const byte *text_end, const CompiledPattern &pattern, size_t min_gap) {
+    size_t patlen = pattern.get_patlen();
+    const byte *window_end = min(chunk->end + patlen - 1, text_end);
+    const byte *p = chunk->start;
+    while (p < chunk->end) {
+        const byte *m = pattern.find(p, window_end - p);
+        chunk->searches.push_back(p);
+        chunk->matches.push_back(m);
+        if (!m) {
+            break;
+        }
+        p = max(p + min_gap, m + patlen);
+    }
+}
+
+vector<const byte *> CompiledPattern::find_all_mt(const byte *text, size_t textlen, size_t min_gap, int num_threads) const {
+    if (num_threads <= 0) {
+        num_threads = (int)std::thread::hardware_concurrency();
+    }
+    size_t num_starts = textlen >= _patlen ? textlen - _patlen + 1 : 0;
+    size_t num_chunks = min((size_t)num_threads * CHUNKS_PER_THREAD, num_starts / MIN_CHUNK_SIZE);
+    if (num_threads <= 1 || num_chunks <= 1) {
+        return find_all(text, textlen, min_gap);
+    }
+
+    const byte *end = text + textlen;
+    vector<ChunkScan> chunks(num_chunks);
+    for (size_t i = 0; i < num_chunks; i++) {
+        chunks[i].start = text + (num_starts * i) / num_chunks;
+        chunks[i].end = text + (num_starts * (i + 1)) / num_chunks;
+    }
+
+    std::atomic<size_t> next_chunk(0);
+    vector<std::thread> threads;
+    for (int t = 0; t < num_threads; t++) {
+        threads.push_back(std::thread([&]() {
+            for (size_t i = next_chunk++; i < num_chunks; i = next_chunk++) {
+                scan_chunk(&chunks[i], end, *this, min_gap);
+            }
+        }));
+    }
+    for (int t = 0; t < num_threads; t++) {
+        threads[t].join();
+    }
+
+    // Replay the serial chain
+    list<const byte *> matches;
+    const byte *p = text;
+    for (size_t c = 0; c < num_chunks; c++) {
+        const ChunkScan &chunk = chunks[c];
+        while (p < chunk.end) {
+            // Last worker search at or before p. searches[0] == chunk.start <= p
+            size_t i = upper_bound(chunk.searches.begin(), chunk.searches.end(), p) - chunk.searches.begin() - 1;
+            const byte *m = chunk.matches[i];
+            if (!m) {
+                // No match starts in [searches[i], chunk.end)
+                p = chunk.end;
+                break;
+            }
+            if (p > m) {
+                // The workers did not scan [p, next search)
+                const byte *next = i + 1 < chunk.searches.size() ? chunk.searches[i + 1] : chunk.end;
+                const byte *window_end = min(next + _patlen - 1, end);
+                m = find(p, window_end - p);
+                if (!m) {
+                    p = next;
+                    continue;
+                }
+            }
+            matches.push_back(m);
+            p = max(p + min_gap, m + _patlen);
+        }
+    }
+
+    return vector<const byte *>(matches.begin(), matches.end());
+}
+
+vector<const byte *> boyer_moore_all_mt(const byte *text, size_t textlen, const byte *pat, size_t patlen, size_t min_gap,
+                                        int num_threads) {
+    return CompiledPattern(pat, patlen).find_all_mt(text, textlen, min_gap, num_threads);
+}
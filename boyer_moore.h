@@ -1,5 +1,116 @@
-#include <list>
-#include "BinString.h"
-
-const byte* boyer_moore(const byte *text, size_t textlen, const byte *pat, size_t patlen);
-std::vector<const byte *> boyer_moore_all(const byte *text, size_t textlen, const byte *pat, size_t patlen, size_t min_gap);
+#ifndef BOYER_MOORE_H
+#define BOYER_MOORE_H
+
+#include <list>
+#include <vector>
+#include "BinString.h"
+#include "search_simd.h"
+
+#define ALPHABET_LEN 256
+
+// Default for set_two_way_min_patlen(). Boyer-Moore tables for a pattern this
+//  long take 4 MB, more than most L2 caches, and Two-Way is as fast on text
+//  that does not match and faster on copies
+#define TWO_WAY_MIN_PATLEN (256*1024)
+
+/*
+ * What the Boyer-Moore search did, to tell which phase a slow case spends
+ *  its time in. Counting costs time in the inner loop, so the counters are
+ *  only kept when the library is compiled with -DBM_STATS. Otherwise they
+ *  stay 0.
+ * Only the Boyer-Moore scan_text() and Two-Way searches are counted.
+ *  Patterns that a SIMD kernel (search_simd.h) or a short pattern kernel
+ *  handles add to num_patterns and the times only.
+ * table_bytes costs nothing to keep so it is kept either way.
+ */
+struct SearchStats {
+    unsigned long long num_patterns;    // patterns compiled, one per candidate tried
+    unsigned long long comparisons;     // text bytes compared with the pattern
+    unsigned long long shifts;          // times the pattern moved on after a mismatch
+    unsigned long long shift_bytes;     // total length of those shifts
+    unsigned long long delta1_wins;     // shifts where delta1 (bad character) was longer
+    unsigned long long delta2_wins;     // shifts where delta2 (good suffix) was as long or longer
+    unsigned long long bytes_touched;   // text, pattern and table bytes read or written
+    double build_seconds;               // building the delta tables
+    double scan_seconds;                // searching the text
+    size_t table_bytes;                 // most memory the tables of one pattern took, scratch included
+
+    SearchStats(): num_patterns(0), comparisons(0), shifts(0), shift_bytes(0), delta1_wins(0),
+                   delta2_wins(0), bytes_touched(0), build_seconds(0.0), scan_seconds(0.0), table_bytes(0) {}
+    double get_average_shift() const { return shifts ? (double)shift_bytes / (double)shifts : 0.0; }
+    void add(const SearchStats &other);
+};
+
+// Return first occurrence of pat in text or NULL, using the tables that
+//  CompiledPattern built for pat
+typedef const byte *(*scan_text_t)(const byte *text, size_t textlen, const byte *pat, size_t patlen,
+                                   const size_t *delta1, const size_t *delta2, SearchStats *stats);
+
+// A search pattern with its Boyer-Moore tables built once, in linear time,
+// so that it can be searched for many times.
+// pat is not copied and must outlive the CompiledPattern.
+class CompiledPattern
+{
+    const byte *_pat;
+    size_t _patlen;
+    simd_search_t _simd;
+    scan_text_t _scan;          // if _simd is NULL and not _two_way
+    bool _two_way;
+    size_t _critical_pos;       // Two-Way factorization pat[0.._critical_pos) pat[_critical_pos..)
+    size_t _period;             // Two-Way shift after a mismatch in the left part
+    bool _periodic;             // _period is the period of the whole pattern
+    size_t _delta1[ALPHABET_LEN];
+    size_t *_delta2;
+    bool _owns_delta2;
+    SearchStats *_stats;
+
+    // Not copyable. _delta2 may be owned
+    CompiledPattern(const CompiledPattern &);
+    CompiledPattern &operator=(const CompiledPattern &);
+
+    // Factorize the pattern for the Two-Way search
+    void make_two_way(SearchStats *stats);
+    const byte *search(const byte *text, size_t textlen, SearchStats *stats) const;
+
+public:
+    CompiledPattern(const byte *pat, size_t patlen);
+    // Build the tables in tables, which is resized as needed and may be
+    //  reused for the next pattern. No memory is allocated once tables has
+    //  grown to 2*patlen. tables must outlive the CompiledPattern.
+    // If stats is not NULL the build and every find() are counted in it, see
+    //  SearchStats. find_all_mt() is not counted
+    CompiledPattern(const byte *pat, size_t patlen, std::vector<size_t> *tables, SearchStats *stats = 0);
+    ~CompiledPattern();
+
+    size_t get_patlen() const { return _patlen; }
+
+    // First match in text or NULL
+    const byte *find(const byte *text, size_t textlen) const;
+
+    // All matches in text, each at least min_gap after the previous one and
+    //  not overlapping it
+    std::vector<const byte *> find_all(const byte *text, size_t textlen, size_t min_gap) const;
+    // Same into matches, which is cleared first, so its memory can be reused
+    void find_all(const byte *text, size_t textlen, size_t min_gap, std::vector<const byte *> *matches) const;
+
+    // Same result as find_all() computed by num_threads threads.
+    // num_threads <= 0 means use all cores.
+    std::vector<const byte *> find_all_mt(const byte *text, size_t textlen, size_t min_gap, int num_threads) const;
+};
+
+// Patterns of at least min_patlen bytes are searched with Two-Way
+//  (Crochemore-Perrin) instead of Boyer-Moore. It is linear in the text too
+//  and its only table is delta1, where Boyer-Moore needs 8 bytes per pattern
+//  byte for delta2 and as many again while building it. 0 means never
+void set_two_way_min_patlen(size_t min_patlen);
+size_t get_two_way_min_patlen();
+
+const byte* boyer_moore(const byte *text, size_t textlen, const byte *pat, size_t patlen);
+std::vector<const byte *> boyer_moore_all(const byte *text, size_t textlen, const byte *pat, size_t patlen, size_t min_gap);
+
+// Same result as boyer_moore_all() computed by num_threads threads.
+// num_threads <= 0 means use all cores.
+std::vector<const byte *> boyer_moore_all_mt(const byte *text, size_t textlen, const byte *pat, size_t patlen, size_t min_gap,
+                                             int num_threads);
+
+#endif
@@ -0,0 +1,262 @@
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <iostream>
+#include "MappedFile.h"
+#include "dedup_writer.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+#endif
+
+using namespace std;
+
+// The Universal Exit Language command that starts a PJL job
+static const char UEL[] = "\x1b%-12345X";
+static const size_t UEL_LEN = sizeof(UEL) - 1;
+
+// A range of the input to write
+struct SpoolExtent {
+    size_t offset;
+    size_t len;
+};
+
+// What to write for result: the input up to the header, the header, then
+//  the rest of the first copy and the job control after the last copy.
+//  Returns false if result does not describe the input
+static bool get_extents(const DetectorResult &result, size_t len, bool starts_with_uel,
+                        SpoolExtent *before, SpoolExtent *copy, SpoolExtent *after) {
+    size_t header_pos = starts_with_uel ? UEL_LEN : 0;
+    if (result.num_copies <= 1) {
+        *before = {0, header_pos};
+        *copy = {header_pos, len - header_pos};
+        *after = {len, 0};
+        return true;
+    }
+    if (result.layout != LAYOUT_COLLATED || (int)result.ends.size() != result.num_copies
+        || result.ends.back() > len || result.ends[0] < header_pos) {
+        return false;
+    }
+    *before = {0, header_pos};
+    *copy = {header_pos, result.ends[0] - header_pos};
+    *after = {result.ends.back(), len - result.ends.back()};
+    return true;
+}
+
+// The count header for result, with a UEL in front if the job has none, in
+//  *header. It is as long as config.count_header makes it. Returns false if
+//  config.count_header is not a valid format
+static bool get_header(const DetectorResult &result, bool starts_with_uel, const DedupConfig &config,
+                       string *header) {
+    header->clear();
+    if (result.num_copies <= 1) {
+        return true;
+    }
+    int len = snprintf(NULL, 0, config.count_header, result.num_copies);
+    if (len < 0) {
+        return false;
+    }
+    string count(len + 1, '\0');
+    snprintf(&count[0], count.size(), config.count_header, result.num_copies);
+    count.resize(len);
+    *header = (starts_with_uel ? "" : UEL) + count;
+    return true;
+}
+
+#ifdef _WIN32
+
+static bool write_all(HANDLE file, const byte *data, size_t len) {
+    while (len > 0) {
+        DWORD n = 0;
+        DWORD request = len > 0x40000000 ? 0x40000000 : (DWORD)len;
+        if (!WriteFile(file, data, request, &n, NULL) || n == 0) {
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+long long write_single_copy(const char *src_path, const DetectorResult &result, const char *dst_path,
+                            const DedupConfig &config, DedupStats *stats) {
+    MappedFile input(src_path);
+    if (!input.is_open()) {
+        return -1;
+    }
+    size_t len = input.get_len();
+    const byte *data = input.get_data();
+    bool starts_with_uel = len >= UEL_LEN && memcmp(data, UEL, UEL_LEN) == 0;
+    SpoolExtent extents[3];
+    if (!get_extents(result, len, starts_with_uel, &extents[0], &extents[1], &extents[2])) {
+        cerr << "write_single_copy: no collated copies in " << src_path << endl;
+        return -1;
+    }
+    string header;
+    if (!get_header(result, starts_with_uel, config, &header)) {
+        cerr << "write_single_copy: bad count header " << config.count_header << endl;
+        return -1;
+    }
+
+    // input is open with FILE_SHARE_READ, so if dst_path is the same file
+    //  this fails before the file is truncated
+    HANDLE output = CreateFileA(dst_path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (output == INVALID_HANDLE_VALUE) {
+        cerr << "write_single_copy: cannot create " << dst_path << endl;
+        return -1;
+    }
+    bool ok = write_all(output, data + extents[0].offset, extents[0].len)
+        && write_all(output, (const byte *)header.data(), header.size())
+        && write_all(output, data + extents[1].offset, extents[1].len)
+        && write_all(output, data + extents[2].offset, extents[2].len);
+    CloseHandle(output);
+    if (!ok) {
+        cerr << "write_single_copy: cannot write " << dst_path << endl;
+        return -1;
+    }
+    size_t num_written = extents[0].len + header.size() + extents[1].len + extents[2].len;
+    if (stats) {
+        stats->bytes_written = num_written;
+        stats->bytes_in_kernel = 0;
+    }
+    return (long long)num_written;
+}
+
+#else
+
+static bool write_all(int fd, const byte *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+// Copy len bytes at offset in src to the end of dst in the kernel. Returns
+//  the number copied, which is less than len if the kernel cannot do it for
+//  these two files
+static size_t send_range(int src_fd, size_t offset, size_t len, int dst_fd) {
+    size_t sent = 0;
+#ifdef __linux__
+    // Both files on file systems that support it, and dst not a pipe or socket
+    while (sent < len) {
+        loff_t src_offset = offset + sent;
+        ssize_t n = copy_file_range(src_fd, &src_offset, dst_fd, NULL, len - sent, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        sent += n;
+    }
+    // Any output
+    while (sent < len) {
+        off_t src_offset = offset + sent;
+        ssize_t n = sendfile(dst_fd, src_fd, &src_offset, len - sent);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        sent += n;
+    }
+#endif
+    return sent;
+}
+
+long long write_single_copy(const char *src_path, const DetectorResult &result, const char *dst_path,
+                            const DedupConfig &config, DedupStats *stats) {
+    int src_fd = open(src_path, O_RDONLY);
+    if (src_fd < 0) {
+        cerr << "write_single_copy: cannot open " << src_path << endl;
+        return -1;
+    }
+    struct stat st;
+    byte start[UEL_LEN];
+    if (fstat(src_fd, &st) != 0) {
+        cerr << "write_single_copy: cannot stat " << src_path << endl;
+        close(src_fd);
+        return -1;
+    }
+    size_t len = (size_t)st.st_size;
+    bool starts_with_uel = pread(src_fd, start, UEL_LEN, 0) == (ssize_t)UEL_LEN
+        && memcmp(start, UEL, UEL_LEN) == 0;
+    SpoolExtent extents[3];
+    if (!get_extents(result, len, starts_with_uel, &extents[0], &extents[1], &extents[2])) {
+        cerr << "write_single_copy: no collated copies in " << src_path << endl;
+        close(src_fd);
+        return -1;
+    }
+    string header;
+    if (!get_header(result, starts_with_uel, config, &header)) {
+        cerr << "write_single_copy: bad count header " << config.count_header << endl;
+        close(src_fd);
+        return -1;
+    }
+
+    // Not truncated until it is known not to be the input, under any name
+    int dst_fd = open(dst_path, O_WRONLY | O_CREAT, 0644);
+    if (dst_fd < 0) {
+        cerr << "write_single_copy: cannot create " << dst_path << endl;
+        close(src_fd);
+        return -1;
+    }
+    struct stat dst_st;
+    bool same_file = fstat(dst_fd, &dst_st) == 0 && dst_st.st_dev == st.st_dev && dst_st.st_ino == st.st_ino;
+    if (same_file || ftruncate(dst_fd, 0) != 0) {
+        cerr << "write_single_copy: " << (same_file ? "output is the input " : "cannot create ") << dst_path << endl;
+        close(dst_fd);
+        close(src_fd);
+        return -1;
+    }
+    bool ok = true;
+    size_t num_written = 0;
+    size_t in_kernel = 0;
+    MappedFile *input = 0;      // only if the kernel cannot copy
+    for (int i = 0; i < 3 && ok; i++) {
+        if (i == 1) {
+            ok = write_all(dst_fd, (const byte *)header.data(), header.size());
+            num_written += header.size();
+        }
+        size_t sent = send_range(src_fd, extents[i].offset, extents[i].len, dst_fd);
+        in_kernel += sent;
+        if (ok && sent < extents[i].len) {
+            if (!input) {
+                input = new MappedFile(src_path);
+            }
+            ok = input->is_open() && input->get_len() == len
+                && write_all(dst_fd, input->get_data() + extents[i].offset + sent, extents[i].len - sent);
+        }
+        num_written += extents[i].len;
+    }
+    delete input;
+    close(src_fd);
+    if (close(dst_fd) != 0 || !ok) {
+        cerr << "write_single_copy: cannot write " << dst_path << endl;
+        return -1;
+    }
+    if (stats) {
+        stats->bytes_written = num_written;
+        stats->bytes_in_kernel = in_kernel;
+    }
+    return (long long)num_written;
+}
+
+#endif
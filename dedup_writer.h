@@ -0,0 +1,47 @@
+#ifndef DEDUP_WRITER_H
+#define DEDUP_WRITER_H
+
+#include <stddef.h>
+#include "Detector.h"
+
+// The PJL command that tells the printer how many copies to print. QTY
+//  prints collated copies of the whole job
+#define DEDUP_COUNT_HEADER "@PJL SET QTY=%d\r\n"
+
+struct DedupConfig {
+    const char *count_header;   // printf format with one %d for the number of copies
+
+    DedupConfig(): count_header(DEDUP_COUNT_HEADER) {}
+};
+
+// How write_single_copy() moved the bytes
+struct DedupStats {
+    size_t bytes_written;       // all of the output, count header included
+    size_t bytes_in_kernel;     // copied file to file by the kernel, never seen by this process
+
+    DedupStats(): bytes_written(0), bytes_in_kernel(0) {}
+};
+
+/*
+ * Rewrite the spool file at src_path, in which result (from a Detector on
+ *  that file) found copies, as one copy and a count header, so the printer
+ *  and the network carry 1/K of the bytes.
+ * The output is the job control before the first copy, the first copy and
+ *  the job control after the last copy, with the count header put straight
+ *  after the job's opening UEL. A job that does not start with a UEL gets a
+ *  UEL and the header in front of it.
+ * The copy goes from file to file in the kernel, with copy_file_range() or,
+ *  where that does not work between the two files, sendfile(). Only if
+ *  neither works is it written from a MappedFile of the input, so it is
+ *  never read into a buffer of this process. On Windows it is always
+ *  written from the MappedFile.
+ * With no copies the file is copied as it is. Uncollated copies are
+ *  interleaved, so there is no one copy to write and that is an error.
+ * dst_path must not be src_path or another name for the same file, which
+ *  is an error rather than truncating the input.
+ * Returns the number of bytes written or -1
+ */
+long long write_single_copy(const char *src_path, const DetectorResult &result, const char *dst_path,
+                            const DedupConfig &config = DedupConfig(), DedupStats *stats = 0);
+
+#endif
@@ -0,0 +1,149 @@
+#include <string.h>
+#include <iostream>
+#include "hash_verify.h"
+
+using namespace std;
+
+static size_t gcd(size_t a, size_t b) {
+    while (b) {
+        size_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+vector<fingerprint_t> prefix_fingerprints(const byte *data, size_t len, size_t num_blocks) {
+    vector<fingerprint_t> prefixes;
+    prefix_fingerprints(data, len, num_blocks, &prefixes);
+    return prefixes;
+}
+
+void prefix_fingerprints(const byte *data, size_t len, size_t num_blocks, vector<fingerprint_t> *prefixes) {
+    size_t block_size = len / num_blocks;
+    prefixes->resize(num_blocks + 1);
+    RollingHash hash;
+    (*prefixes)[0] = hash.get();
+    for (size_t i = 0; i < num_blocks; i++) {
+        hash.update(data + i * block_size, block_size);
+        (*prefixes)[i + 1] = hash.get();
+    }
+}
+
+/*
+ * The hash stops at every block boundary and at the start and end of every
+ *  page, in order. A page's fingerprint is then the region between the
+ *  prefix hashes at its two ends, so the pages cost no extra reading
+ */
+void prefix_fingerprints(const byte *data, size_t len, size_t num_blocks, vector<fingerprint_t> *prefixes,
+                         const PageIndex &pages, vector<fingerprint_t> *page_hashes) {
+    size_t block_size = num_blocks > 0 ? len / num_blocks : 0;
+    size_t num_pages = pages.get_num_pages();
+    prefixes->resize(num_blocks > 0 ? num_blocks + 1 : 0);
+    page_hashes->resize(num_pages);
+    RollingHash hash;
+    size_t pos = 0;                 // hash is H(data[0..pos))
+    size_t block = 0;               // next block boundary is block * block_size
+    size_t page = 0;
+    bool in_page = false;
+    fingerprint_t page_start = 0;   // H(data[0..starts[page])) once in_page
+    for (;;) {
+        bool blocks_left = num_blocks > 0 && block <= num_blocks;
+        size_t next = blocks_left ? block * block_size : len + 1;
+        if (page < num_pages) {
+            next = min(next, in_page ? pages.ends[page] : pages.starts[page]);
+        }
+        if (next > len) {
+            break;
+        }
+        hash.update(data + pos, next - pos);
+        pos = next;
+        fingerprint_t h = hash.get();
+        if (blocks_left && pos == block * block_size) {
+            (*prefixes)[block++] = h;
+        }
+        if (page < num_pages && !in_page && pos == pages.starts[page]) {
+            page_start = h;
+            in_page = true;
+        }
+        if (in_page && pos == pages.ends[page]) {
+            (*page_hashes)[page] = RollingHash::region(page_start, h,
+                                                       RollingHash::power(pages.ends[page] - pages.starts[page]));
+            page++;
+            in_page = false;
+        }
+    }
+}
+
+/*
+ * Every copy boundary of every candidate is a multiple of len/num_blocks where
+ *  num_blocks is the lcm of the candidates. (Candidates are factors of the
+ *  number of pages so num_blocks is at most the number of pages.)
+ * The prefix hashes at these block boundaries give the fingerprint of any
+ *  candidate copy in O(1), so checking num_copies costs O(num_copies) after
+ *  the single pass over data.
+ */
+size_t hash_num_blocks(size_t len, const vector<int> &numcopies_candidates, vector<int> *candidates) {
+    // Copies have equal lengths so only candidates that divide len can match
+    candidates->clear();
+    size_t num_blocks = 1;
+    for (unsigned int i = 0; i < numcopies_candidates.size(); i++) {
+        int num_copies = numcopies_candidates[i];
+        if (num_copies > 1 && len % num_copies == 0) {
+            candidates->push_back(num_copies);
+            num_blocks = num_blocks / gcd(num_blocks, num_copies) * num_copies;
+        }
+    }
+    return candidates->empty() ? 0 : num_blocks;
+}
+
+int hash_find_num_copies(const byte *data, size_t len, vector<int> numcopies_candidates, bool confirm,
+                         ScanStats *stats) {
+
+    vector<int> candidates;
+    size_t num_blocks = hash_num_blocks(len, numcopies_candidates, &candidates);
+    if (num_blocks == 0) {
+        return -1;
+    }
+
+    vector<fingerprint_t> prefixes = prefix_fingerprints(data, len, num_blocks);
+    if (stats) {
+        stats->bytes_read += len;
+    }
+    return hash_check_copies(data, len, candidates, prefixes, confirm, stats);
+}
+
+int hash_check_copies(const byte *data, size_t len, const vector<int> &candidates,
+                      const vector<fingerprint_t> &prefixes, bool confirm, ScanStats *stats) {
+
+    size_t num_blocks = prefixes.size() - 1;
+    for (unsigned int i = 0; i < candidates.size(); i++) {
+        int num_copies = candidates[i];
+        size_t copy_size = len / num_copies;
+        size_t copy_blocks = num_blocks / num_copies;
+        fingerprint_t pow_copy = RollingHash::power(copy_size);
+        fingerprint_t first_copy = RollingHash::region(prefixes[0], prefixes[copy_blocks], pow_copy);
+
+        bool match = true;
+        for (int n = 1; n < num_copies && match; n++) {
+            fingerprint_t copy = RollingHash::region(prefixes[n * copy_blocks],
+                                                     prefixes[(n + 1) * copy_blocks], pow_copy);
+            match = (copy == first_copy);
+        }
+        if (!match) {
+            continue;
+        }
+        // data is made of num_copies copies iff it has a period of copy_size
+        if (confirm) {
+            if (stats) {
+                stats->bytes_read += 2 * (len - copy_size);
+            }
+            if (memcmp(data, data + copy_size, len - copy_size) != 0) {
+                cerr << "hash_find_num_copies: hash collision for num_copies=" << num_copies << endl;
+                continue;
+            }
+        }
+        return num_copies;
+    }
+    return -1;
+}
@@ -0,0 +1,50 @@
+#ifndef HASH_VERIFY_H
+#define HASH_VERIFY_H
+
+#include <vector>
+#include "BinString.h"
+#include "RollingHash.h"
+#include "PageIndex.h"
+#include "inline_copies.h"
+
+// Prefix hashes H(data[0..i*len/num_blocks)) for i = 0..num_blocks, computed
+//  in one linear pass. num_blocks must divide len
+std::vector<fingerprint_t> prefix_fingerprints(const byte *data, size_t len, size_t num_blocks);
+// Same into prefixes, so its memory can be reused
+void prefix_fingerprints(const byte *data, size_t len, size_t num_blocks, std::vector<fingerprint_t> *prefixes);
+// Same, and in the same pass the fingerprint of every page in pages, as
+//  page_fingerprints() would give. num_blocks may be 0 for no prefixes
+void prefix_fingerprints(const byte *data, size_t len, size_t num_blocks, std::vector<fingerprint_t> *prefixes,
+                         const PageIndex &pages, std::vector<fingerprint_t> *page_hashes);
+
+// Rolling hash alternative to find_num_copies().
+// All candidate copy regions are fingerprinted in a single pass over data
+//  and every candidate is checked against those fingerprints, so there are no
+//  Boyer-Moore tables and the cost does not depend on the copy size.
+// Candidates are tested largest first. If K copies match then so do all K'
+//  that divide K, so the first match is the answer.
+// If confirm is true the winning candidate is checked with memcmp so a hash
+//  collision cannot give a false positive. That reads the input a second time.
+//  Without it data is read exactly once (stats->bytes_read == len). Two
+//  different copies of n bytes then collide under each base with chance at
+//  most n/2^31, over the choice of base. The bases are fixed constants, not
+//  chosen per run, so that is a bound for ordinary spool data only: input
+//  crafted against RollingHash can give a false positive every time, so
+//  ENGINE_SINGLE_PASS must not be trusted with adversarial input.
+// Returns the largest number of copies found or -1 if there are none.
+int hash_find_num_copies(const byte *data, size_t len, std::vector<int> numcopies_candidates, bool confirm,
+                         ScanStats *stats = 0);
+
+// The candidates hash_find_num_copies() tests (those that divide len) and the
+//  number of blocks it fingerprints for them, the lcm of the candidates.
+// Returns 0 if no candidate can match
+size_t hash_num_blocks(size_t len, const std::vector<int> &numcopies_candidates, std::vector<int> *candidates);
+
+// The second half of hash_find_num_copies(): check candidates against prefix
+//  fingerprints that have already been computed, e.g. in pieces by several
+//  threads. prefixes are as returned by prefix_fingerprints(data, len, num_blocks)
+//  with num_blocks from hash_num_blocks()
+int hash_check_copies(const byte *data, size_t len, const std::vector<int> &candidates,
+                      const std::vector<fingerprint_t> &prefixes, bool confirm, ScanStats *stats = 0);
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef INLINE_COPIES_H
+#define INLINE_COPIES_H
+
+#include <list>
+#include <vector>
+#include "BinString.h"
+#include "boyer_moore.h"
+
+// How much of the input a detection read. bytes_read counts every byte of
+//  input that is scanned, hashed or compared, so get_passes() is the number
+//  of passes over the input. search says where the Boyer-Moore engine spent
+//  its time, when compiled with -DBM_STATS
+struct ScanStats {
+    size_t input_bytes;
+    size_t bytes_read;
+    SearchStats search;
+    ScanStats(): input_bytes(0), bytes_read(0) {}
+    double get_passes() const { return input_bytes ? (double)bytes_read / (double)input_bytes : 0.0; }
+};
+
+// Receives progress messages from the detection functions
+typedef void (*log_callback_t)(void *context, const char *message);
+
+// Where the detection functions send progress messages. With no callback,
+//  the default, messages are not even formatted
+struct CopyLog {
+    log_callback_t callback;
+    void *context;
+    CopyLog(log_callback_t callback = 0, void *context = 0): callback(callback), context(context) {}
+    bool enabled() const { return callback != 0; }
+    // printf() style. Call only if enabled()
+    void log(const char *format, ...) const;
+};
+
+// Hex dump of the start of data when verbose output is compiled in
+void show_data(const byte *data, size_t len, const char *desc);
+
+// Candidate numbers of copies of a num_pages document, largest first
+const std::vector<int> get_factors(int number);
+void get_factors(int number, std::vector<int> *factors);
+
+// Memory that find_repeats() and find_num_copies() reuse from one call to
+//  the next, so that they do not allocate once it has grown
+struct SearchScratch {
+    std::vector<size_t> tables;             // Boyer-Moore tables
+    std::vector<const byte *> matches;
+    std::vector<size_t> repeats;            // result of find_repeats()
+    std::vector<int> candidates;
+};
+
+// Number of threads find_repeats() uses for its Boyer-Moore search.
+// 1 (the default) is serial and <= 0 means use all cores
+void set_search_threads(int num_threads);
+
+// Bytes at the ends of each copy that find_repeats() leaves out of its
+//  pattern, so that per-copy headers such as "copy 3 of 5" do not prevent
+//  a match. Default 0
+void set_copy_header_size(size_t header_size);
+
+// Windows find_copies() samples per candidate before checking it in full,
+//  see sample_filter_candidates(). 0 turns sampling off. Default SAMPLE_BUDGET
+void set_sample_budget(size_t budget);
+
+std::vector<size_t> find_repeats(const byte *data, size_t len, int num_copies, size_t *repeat_len,
+                                 ScanStats *stats = 0);
+// find_repeats() with the header size and number of threads given rather
+//  than set globally. The offsets are returned in scratch->repeats. Does
+//  not allocate once scratch has grown, unless num_threads != 1
+void find_repeats(const byte *data, size_t len, int num_copies, size_t header_size, int num_threads,
+                  const CopyLog &log, SearchScratch *scratch, size_t *repeat_len, ScanStats *stats);
+std::vector<int> filter_candidates(std::vector<int> numcopies_candidates, std::vector<size_t> repeats);
+std::vector<int> filter_candidates2(std::vector<int> numcopies_candidates, std::list<std::vector<size_t> > all_repeats);
+
+int find_num_copies(const byte *data, size_t len, int num_pages, std::vector<int> numcopies_candidates,
+                    ScanStats *stats = 0);
+// find_num_copies() with explicit settings that also returns the offsets of
+//  the copies found. Allocates no memory once scratch and offsets have grown,
+//  unless num_threads != 1
+int find_num_copies(const byte *data, size_t len, int num_pages, const std::vector<int> &numcopies_candidates,
+                    size_t header_size, int num_threads, const CopyLog &log,
+                    SearchScratch *scratch, std::vector<size_t> *offsets, ScanStats *stats);
+
+// How find_copies() verifies candidate numbers of copies
+enum CopyEngine {
+    ENGINE_BOYER_MOORE,     // find_num_copies(): a find_repeats() scan per candidate
+    ENGINE_ROLLING_HASH,    // hash_find_num_copies(): one pass for all candidates + memcmp
+    ENGINE_SINGLE_PASS,     // hash_find_num_copies() without memcmp: exactly one pass
+    ENGINE_SAMPLED_ANCHOR,  // anchor_find_num_copies(): short probes, then memcmp survivors
+    ENGINE_PAGE_INDEX,      // page_find_num_copies(): copies start at page breaks found by index_pages()
+    ENGINE_PERIOD,          // period_find_num_copies(): one smallest period search, no tables
+    ENGINE_RUN_LENGTH       // run_length_find_num_copies(): long byte runs compared a run at a time
+};
+
+// Return number of inline copies in data or -1 if there are none.
+// Detector in Detector.h does the same and also returns where the copies are
+int find_copies(const byte *data, size_t len, int num_pages, CopyEngine engine = ENGINE_ROLLING_HASH,
+                ScanStats *stats = 0);
+int find_copies(const BinString &input, int num_pages, CopyEngine engine = ENGINE_ROLLING_HASH);
+int find_copies_file(const char *path, int num_pages, CopyEngine engine = ENGINE_ROLLING_HASH);
+
+#endif
@@ -0,0 +1,1260 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <new>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <iostream>
+#include "BinString.h"
+#include "StreamDetector.h"
+#include "BlockReader.h"
+#include "Detector.h"
+#include "BatchDetector.h"
+#include "search_simd.h"
+#include "PageIndex.h"
+#include "hash_verify.h"
+#include "FingerprintIndex.h"
+#include "sample_filter.h"
+#include "period.h"
+#include "run_length.h"
+#include "near_duplicate.h"
+#include "dedup_writer.h"
+#include "MappedFile.h"
+#include "make_copies.h"
+#include "inline_copies.h"
+
+/*
+ * inline_copies <spool file> <num pages> reports the number of copies in a
+ *  spool file. With no arguments it checks all the engines on test data
+ */
+using namespace std;
+
+// Odd size so that chunks do not line up with copy boundaries
+static const size_t STREAM_CHUNK_SIZE = 64*1024 + 1;
+
+// Count the heap allocations made by the program so run_alloc_test() can
+//  check that detection with a workspace makes none
+static std::atomic<size_t> _num_allocations(0);
+
+void *operator new(size_t size) {
+    _num_allocations++;
+    void *p = malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+// Not inlined, or GCC warns that memory from operator new is passed to free()
+#ifdef __GNUC__
+__attribute__((noinline))
+#endif
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+static void log_to_cout(void *, const char *message) {
+    cout << message << endl;
+}
+
+// true if result describes num_copies back to back copies of copy_size bytes
+//  and every larger candidate was rejected
+static bool check_result(const DetectorResult &result, int num_pages, int num_copies, size_t copy_size) {
+    if (result.num_copies != num_copies || result.copy_size != copy_size
+        || (int)result.offsets.size() != num_copies) {
+        return false;
+    }
+    for (int i = 0; i < num_copies; i++) {
+        if (result.offsets[i] != i * copy_size) {
+            return false;
+        }
+    }
+    vector<int> candidates = get_factors(num_pages);
+    unsigned int num_larger = 0;
+    while (num_larger < candidates.size() && candidates[num_larger] > num_copies) {
+        num_larger++;
+    }
+    return result.rejected == vector<int>(candidates.begin(), candidates.begin() + num_larger);
+}
+
+/*
+ * Check that all the engines find num_copies copies in test data.
+ *  Timing is done by benchmark.cpp
+ */
+bool run_test(int num_pages, int num_copies, size_t copy_size) {
+   
+    assert(num_pages >= num_copies);
+    assert(num_pages % num_copies == 0);
+    int pages_copy = num_pages / num_copies;
+    // Round up copy to next multiple of page per copy
+    copy_size = ((copy_size + pages_copy - 1)/pages_copy) * pages_copy;
+    const BinString *bin_string_ptr = make_copies(num_copies, copy_size);
+    const BinString &bin_string = *bin_string_ptr;
+  
+    show_data(bin_string.get_data(), bin_string.get_len(), "main");
+    cout << "---------------" << endl;
+    cout << "Input num_pages=" << num_pages 
+        << ",num_copies=" << num_copies 
+        << ",copy_size=" << (int)copy_size
+        << ",file size=" << (double)copy_size * (double)num_copies/1024.0/1024.0 << " MB"
+        << endl;
+
+    int found_num_copies = find_copies(bin_string, num_pages, ENGINE_BOYER_MOORE);
+    cout << "-----------------------------------------------" << endl;
+    cout << "Found " << found_num_copies << " copies" << endl;
+    cout << "==============================================" << endl;
+
+    // The streaming detector must find the same copies when fed in chunks
+    StreamDetector stream(bin_string.get_len(), num_pages);
+    for (size_t ofs = 0; ofs < bin_string.get_len(); ofs += STREAM_CHUNK_SIZE) {
+        size_t n = min(STREAM_CHUNK_SIZE, bin_string.get_len() - ofs);
+        stream.push(bin_string.get_data() + ofs, n);
+    }
+    int stream_num_copies = stream.finish();
+    cout << "StreamDetector found " << stream_num_copies << " copies" << endl;
+
+    // So must the rolling hash verifier, and in a single pass when it does
+    //  not confirm with memcmp and does not sample first
+    int hash_num_copies = find_copies(bin_string, num_pages, ENGINE_ROLLING_HASH);
+    cout << "hash_find_num_copies found " << hash_num_copies << " copies" << endl;
+    ScanStats stats;
+    set_sample_budget(0);
+    int single_pass_num_copies = find_copies(bin_string.get_data(), bin_string.get_len(), num_pages,
+                                             ENGINE_SINGLE_PASS, &stats);
+    set_sample_budget(SAMPLE_BUDGET);
+    cout << "single pass found " << single_pass_num_copies << " copies in "
+        << stats.get_passes() << " passes" << endl;
+    
+    // And the sampled-anchor search
+    int anchor_num_copies = find_copies(bin_string, num_pages, ENGINE_SAMPLED_ANCHOR);
+    cout << "anchor_find_num_copies found " << anchor_num_copies << " copies" << endl;
+
+    // And the smallest period
+    int period_num_copies = find_copies(bin_string, num_pages, ENGINE_PERIOD);
+    cout << "period_find_num_copies found " << period_num_copies << " copies" << endl;
+
+    // And the run-length comparison
+    int run_num_copies = find_copies(bin_string, num_pages, ENGINE_RUN_LENGTH);
+    cout << "run_length_find_num_copies found " << run_num_copies << " copies" << endl;
+
+    // Detector must say where the copies are for every engine
+    bool detector_ok = true;
+    const CopyEngine engines[] = {ENGINE_BOYER_MOORE, ENGINE_ROLLING_HASH, ENGINE_SINGLE_PASS, ENGINE_SAMPLED_ANCHOR,
+                                  ENGINE_PERIOD, ENGINE_RUN_LENGTH};
+    for (unsigned int i = 0; i < sizeof(engines) / sizeof(engines[0]); i++) {
+        DetectorConfig config;
+        config.engine = engines[i];
+        DetectorResult result = Detector(config).detect(bin_string, num_pages);
+        detector_ok = detector_ok && check_result(result, num_pages, num_copies, copy_size);
+    }
+    cout << "Detector " << (detector_ok ? "found" : "did not find") << " the copy offsets" << endl;
+    
+    bool ok = (found_num_copies == num_copies) && (stream_num_copies == num_copies)
+        && (hash_num_copies == num_copies) && (single_pass_num_copies == num_copies)
+        && (stats.bytes_read == stats.input_bytes) && (anchor_num_copies == num_copies)
+        && (period_num_copies == num_copies) && (run_num_copies == num_copies) && detector_ok;
+    if (!ok) {
+        cerr << "run_test failed: num_pages=" << num_pages
+            << ",num_copies=" << num_copies 
+            << ",copy_size=" << (int)copy_size << endl;
+        cerr << "error!!!" << endl;
+    }
+
+    delete bin_string_ptr;
+    return ok;
+
+}
+
+/*
+ * Copies with a different banner in each must be found by the near-duplicate
+ *  search, with the banners reported, and by find_repeats() with a header
+ *  allowance. The exact search must not find them
+ */
+bool run_near_test(int num_pages, int num_copies, size_t copy_size) {
+    BinString *bin_string_ptr = (BinString *)make_copies(num_copies, copy_size);
+    stamp_copies(bin_string_ptr->get_data(), num_copies, copy_size);
+    const byte *data = bin_string_ptr->get_data();
+    size_t len = bin_string_ptr->get_len();
+
+    NearDuplicateOptions options;
+    options.max_prefix = 2 * COPY_STAMP_SIZE;
+    vector<DiffRegion> regions;
+    int near_num_copies = near_find_num_copies(data, len, get_factors(num_pages), options, &regions);
+    bool regions_ok = (int)regions.size() == num_copies - 1;
+    for (unsigned int i = 0; i < regions.size(); i++) {
+        regions_ok = regions_ok && regions[i].offset < COPY_STAMP_SIZE && regions[i].len <= COPY_STAMP_SIZE;
+    }
+
+    set_copy_header_size(2 * COPY_STAMP_SIZE);
+    int bm_num_copies = find_copies(data, len, num_pages, ENGINE_BOYER_MOORE);
+    set_copy_header_size(0);
+
+    int exact_num_copies = find_copies(data, len, num_pages, ENGINE_ROLLING_HASH);
+
+    cout << "near duplicates: found " << near_num_copies << " copies with "
+        << (int)regions.size() << " differing regions, find_repeats with header found "
+        << bm_num_copies << ", exact found " << exact_num_copies << endl;
+
+    bool ok = near_num_copies == num_copies && regions_ok && bm_num_copies == num_copies
+        && exact_num_copies != num_copies;
+    if (!ok) {
+        cerr << "run_near_test failed: num_pages=" << num_pages
+            << ",num_copies=" << num_copies 
+            << ",copy_size=" << (int)copy_size << endl;
+        cerr << "error!!!" << endl;
+    }
+    delete bin_string_ptr;
+    return ok;
+}
+
+/*
+ * BatchDetector must give the same results as Detector, including for jobs
+ *  small enough to be split into many pieces
+ */
+bool run_batch_test(CopyEngine engine, size_t split_size) {
+    const int num_jobs = 6;
+    const int pages[num_jobs] = {4, 400, 34, 6, 20, 51};
+    const int copies[num_jobs] = {2, 200, 17, 3, 2, 17};
+    const size_t copy_sizes[num_jobs] = {40, 500, 50*1000, 7777, 100*1000, 3001};
+
+    vector<const BinString *> inputs;
+    vector<BatchJob> jobs;
+    for (int i = 0; i < num_jobs; i++) {
+        BinString *input = (BinString *)make_copies(copies[i], copy_sizes[i]);
+        if (i == num_jobs - 1) {
+            // Not copies
+            input->get_data()[input->get_len() - 1] ^= 1;
+        }
+        inputs.push_back(input);
+        jobs.push_back(BatchJob("job", pages[i], input->get_data(), input->get_len()));
+    }
+
+    DetectorConfig config;
+    config.engine = engine;
+    BatchResult batch = BatchDetector(config, 3, split_size).run(jobs);
+
+    bool ok = batch.files.size() == jobs.size();
+    for (unsigned int i = 0; ok && i < jobs.size(); i++) {
+        DetectorResult expected = Detector(config).detect(jobs[i].data, jobs[i].len, jobs[i].num_pages);
+        const DetectorResult &result = batch.files[i].result;
+        ok = batch.files[i].ok && result.num_copies == expected.num_copies && result.offsets == expected.offsets
+            && result.rejected == expected.rejected && result.stats.bytes_read == expected.stats.bytes_read;
+    }
+    cout << "batch of " << (int)jobs.size() << " jobs with split size " << (int)split_size << ": "
+        << batch.get_gb_per_sec() << " GB/s, p50 latency " << batch.get_latency(0.5)
+        << " sec, p99 latency " << batch.get_latency(0.99) << " sec" << endl;
+    if (!ok) {
+        cerr << "run_batch_test failed: engine=" << engine << ",split_size=" << (int)split_size << endl;
+        cerr << "error!!!" << endl;
+    }
+
+    for (unsigned int i = 0; i < inputs.size(); i++) {
+        delete inputs[i];
+    }
+    return ok;
+}
+
+/*
+ * Copies of real page description languages have pages of different sizes
+ *  and job control between them that differs from copy to copy. The page
+ *  index engine must find them where the len/num_copies engines cannot,
+ *  collated or not, and must not find copies that differ in one byte
+ */
+bool run_page_test(const char *format, int num_copies, int pages_per_copy, size_t page_size, bool collated) {
+    bool pcl = strcmp(format, "pcl") == 0;
+    BinString *bin_string_ptr = (BinString *)(pcl
+        ? make_pcl_spool(num_copies, pages_per_copy, page_size, collated)
+        : make_postscript_spool(num_copies, pages_per_copy, page_size, collated));
+    const BinString &spool = *bin_string_ptr;
+    int num_pages = num_copies * pages_per_copy;
+
+    PageIndex index;
+    const PageFormat *page_format = index_pages(spool.get_data(), spool.get_len(), &index);
+    bool ok = strcmp(page_format->name, format) == 0 && (int)index.get_num_pages() == num_pages;
+
+    DetectorConfig config;
+    config.engine = ENGINE_PAGE_INDEX;
+    DetectorResult result = Detector(config).detect(spool, num_pages);
+    int expected_num_copies = num_copies > 1 ? num_copies : -1;
+    // Copies of one page are both, and count as collated
+    CopyLayout expected_layout = num_copies == 1 ? LAYOUT_NONE
+        : collated || pages_per_copy == 1 ? LAYOUT_COLLATED : LAYOUT_UNCOLLATED;
+    ok = ok && result.num_copies == expected_num_copies && result.layout == expected_layout;
+    int first_page_step = expected_layout == LAYOUT_UNCOLLATED ? 1 : pages_per_copy;
+    for (int i = 0; ok && i < num_copies && num_copies > 1; i++) {
+        ok = result.offsets[i] == index.starts[i * first_page_step];
+    }
+    // An uncollated copy is every num_copies'th page
+    size_t expected_copy_size = 0;
+    if (expected_layout == LAYOUT_COLLATED) {
+        expected_copy_size = index.starts[pages_per_copy] - index.starts[0];
+    } else if (expected_layout == LAYOUT_UNCOLLATED) {
+        for (int i = 0; i < num_pages; i += num_copies) {
+            expected_copy_size += index.ends[i] - index.starts[i];
+        }
+    }
+    ok = ok && result.copy_size == expected_copy_size;
+
+    // Comparing the pages finds the same copies, at the cost of reading them again
+    DetectorConfig confirm_config = config;
+    confirm_config.confirm_pages = true;
+    DetectorResult confirmed = Detector(confirm_config).detect(spool, num_pages);
+    ok = ok && confirmed.num_copies == result.num_copies && confirmed.layout == result.layout
+        && (num_copies == 1 || confirmed.stats.bytes_read > result.stats.bytes_read);
+    int hash_num_copies = find_copies(spool, num_pages, ENGINE_ROLLING_HASH);
+
+    // Change a byte in the middle of the last page
+    size_t last = index.get_num_pages() - 1;
+    spool.get_data()[(index.starts[last] + index.ends[last]) / 2] ^= 0x40;
+    int changed_num_copies = Detector(config).detect(spool, num_pages).num_copies;
+    ok = ok && (num_copies == 1 || changed_num_copies != num_copies);
+
+    cout << format << (collated ? "" : " uncollated") << " spool of " << num_pages << " pages: page index found "
+        << result.num_copies << " copies, rolling hash found " << hash_num_copies
+        << ", after a change page index found " << changed_num_copies << endl;
+    if (!ok) {
+        cerr << "run_page_test failed: format=" << format << ",num_copies=" << num_copies
+            << ",pages_per_copy=" << pages_per_copy << ",collated=" << collated << endl;
+        cerr << "error!!!" << endl;
+    }
+    delete bin_string_ptr;
+    return ok;
+}
+
+/*
+ * A FingerprintIndex must recognise a spool it has seen before, also when it
+ *  is opened again as another process would, and only the pages that are
+ *  the same when a spool has been changed. engine is the copy engine, as
+ *  all engines must fill in the index
+ */
+bool run_index_test(CopyEngine engine) {
+    const char *path = "inline.copies.idx";
+    remove(path);
+    // The other engines fingerprint chunks, which are set to 4 to a copy
+    //  like the pages
+    bool by_page = engine == ENGINE_PAGE_INDEX;
+    const size_t chunk_size = 2000;
+    BinString *spool = (BinString *)(by_page ? make_pcl_spool(3, 4, 2000) : make_copies(3, 4 * chunk_size));
+    const int num_pages = 12;
+    const int num_unique = 4;
+    // Only the engines that do not hash the input read it again for the index
+    bool hashes = by_page || engine == ENGINE_ROLLING_HASH || engine == ENGINE_SINGLE_PASS;
+    size_t index_bytes_read = hashes ? 0 : spool->get_len();
+
+    bool ok = true;
+    DetectorResult plain, first, again, changed;
+    size_t capacity, count, count_changed;
+    {
+        FingerprintIndex index(path, 10);
+        DetectorConfig config;
+        config.engine = engine;
+        config.fingerprint_chunk_size = chunk_size;
+        plain = Detector(config).detect(*spool, num_pages);
+        config.fingerprints = &index;
+        config.job_id = 1;
+        first = Detector(config).detect(*spool, num_pages);
+        capacity = index.get_capacity();
+        count = index.get_count();
+        ok = index.is_open();
+    }
+    {
+        // Capacity is that of the existing file
+        FingerprintIndex index(path, 1000);
+        DetectorConfig config;
+        config.engine = engine;
+        config.fingerprint_chunk_size = chunk_size;
+        config.fingerprints = &index;
+        config.job_id = 2;
+        again = Detector(config).detect(*spool, num_pages);
+        ok = ok && index.get_capacity() == capacity && index.get_count() == count;
+
+        // Change a byte in the middle of the last page
+        PageIndex pages;
+        if (by_page) {
+            index_pages(spool->get_data(), spool->get_len(), &pages);
+        } else {
+            chunk_pages(spool->get_len(), chunk_size, &pages);
+        }
+        // Pages fingerprinted in the hash pass, with the gaps between pages
+        //  that job control leaves, are as page_fingerprints() finds them
+        vector<fingerprint_t> prefixes, page_hashes, expected_hashes;
+        page_fingerprints(spool->get_data(), spool->get_len(), pages, &expected_hashes);
+        prefix_fingerprints(spool->get_data(), spool->get_len(), 3, &prefixes, pages, &page_hashes);
+        ok = ok && page_hashes == expected_hashes
+            && prefixes == prefix_fingerprints(spool->get_data(), spool->get_len(), 3);
+        size_t last = pages.get_num_pages() - 1;
+        spool->get_data()[(pages.starts[last] + pages.ends[last]) / 2] ^= 0x40;
+        config.job_id = 3;
+        changed = Detector(config).detect(*spool, num_pages);
+        count_changed = index.get_count();
+    }
+    remove(path);
+
+    ok = ok && capacity == 16 && count == num_unique && count_changed == num_unique + 1;
+    ok = ok && first.known_pages == 0 && first.reprint_of == -1 && first.num_copies == 3;
+    ok = ok && first.stats.bytes_read == plain.stats.bytes_read + index_bytes_read;
+    ok = ok && again.known_pages == num_pages && again.reprint_of == 1;
+    ok = ok && changed.known_pages == num_pages - 1 && changed.reprint_of == -1;
+    cout << "fingerprint index: " << again.known_pages << " of " << num_pages << " pages known in a reprint, "
+        << changed.known_pages << " after a change, " << count_changed << " of " << capacity << " slots used" << endl;
+    if (!ok) {
+        cerr << "run_index_test failed: engine=" << engine << endl;
+        cerr << "error!!!" << endl;
+    }
+    delete spool;
+    return ok;
+}
+
+/*
+ * The pool threads of a BatchDetector share one FingerprintIndex. Every page
+ *  of every job must be added exactly once, so that each job is then known
+ *  in full. The jobs have pages of different sizes, so none are shared
+ */
+bool run_batch_index_test(int num_jobs, int num_threads) {
+    const char *path = "inline.copies.idx";
+    remove(path);
+    const int num_copies = 2;
+    const int pages_per_copy = 5;
+    const int num_pages = num_copies * pages_per_copy;
+
+    vector<const BinString *> inputs;
+    vector<BatchJob> jobs;
+    for (int i = 0; i < num_jobs; i++) {
+        const BinString *input = make_pcl_spool(num_copies, pages_per_copy, 1000 + 97 * i);
+        inputs.push_back(input);
+        jobs.push_back(BatchJob("job", num_pages, input->get_data(), input->get_len()));
+    }
+
+    bool ok = true;
+    int num_known = 0;
+    size_t count = 0;
+    {
+        FingerprintIndex index(path, 4096);
+        DetectorConfig config;
+        config.engine = ENGINE_PAGE_INDEX;
+        config.fingerprints = &index;
+        config.job_id = 1;
+        BatchResult batch = BatchDetector(config, num_threads).run(jobs);
+        ok = index.is_open() && batch.files.size() == jobs.size();
+        count = index.get_count();
+        for (int i = 0; i < num_jobs && ok; i++) {
+            DetectorResult result = Detector(config).detect(jobs[i].data, jobs[i].len, num_pages);
+            ok = batch.files[i].ok && batch.files[i].result.num_copies == num_copies
+                && result.known_pages == num_pages;
+            num_known += ok ? 1 : 0;
+        }
+    }
+    remove(path);
+    ok = ok && count == (size_t)(num_jobs * pages_per_copy);
+
+    cout << "fingerprint index shared by " << num_threads << " threads: " << count << " pages added, "
+        << num_known << " of " << num_jobs << " jobs known" << endl;
+    if (!ok) {
+        cerr << "run_batch_index_test failed: num_jobs=" << num_jobs << ",num_threads=" << num_threads << endl;
+        cerr << "error!!!" << endl;
+    }
+    for (unsigned int i = 0; i < inputs.size(); i++) {
+        delete inputs[i];
+    }
+    return ok;
+}
+
+/*
+ * Sampling must keep every candidate that divides num_copies, as those
+ *  copies are exact, and drop the others that divide the length after
+ *  reading a few KB. A change
+ *  in the middle of one copy is likely to get past the sampling, and then
+ *  the full check must reject it
+ */
+bool run_sample_test(int num_pages, int num_copies, size_t copy_size) {
+    BinString *bin_string_ptr = (BinString *)make_copies(num_copies, copy_size);
+    const BinString &bin_string = *bin_string_ptr;
+
+    vector<int> candidates = get_factors(num_pages);
+    // Candidates that do not divide the length are left to the full check
+    vector<int> expected;
+    for (unsigned int i = 0; i < candidates.size(); i++) {
+        if (num_copies % candidates[i] == 0 || bin_string.get_len() % candidates[i] != 0) {
+            expected.push_back(candidates[i]);
+        }
+    }
+    vector<int> sampled = candidates;
+    ScanStats stats;
+    sample_filter_candidates(bin_string.get_data(), bin_string.get_len(), &sampled, SAMPLE_BUDGET, &stats);
+    bool ok = sampled == expected;
+    ok = ok && stats.bytes_read <= candidates.size() * (SAMPLE_BUDGET + 2) * 2 * SAMPLE_WINDOW;
+
+    // Change the middle of the middle copy
+    bin_string.get_data()[(num_copies / 2) * copy_size + copy_size / 2] ^= 0x40;
+    vector<int> changed_sampled = candidates;
+    sample_filter_candidates(bin_string.get_data(), bin_string.get_len(), &changed_sampled);
+    int changed_num_copies = Detector().detect(bin_string, num_pages).num_copies;
+    ok = ok && changed_num_copies != num_copies;
+
+    cout << "sampling kept " << sampled.size() << " of " << candidates.size() << " candidates reading "
+        << stats.bytes_read << " of " << bin_string.get_len() << " bytes, " << changed_sampled.size()
+        << " after a change, which has " << changed_num_copies << " copies" << endl;
+    if (!ok) {
+        cerr << "run_sample_test failed: num_pages=" << num_pages << ",num_copies=" << num_copies
+            << ",copy_size=" << copy_size << endl;
+        cerr << "error!!!" << endl;
+    }
+    delete bin_string_ptr;
+    return ok;
+}
+
+// Smallest period of data[0..len) the slow way
+static size_t naive_period(const byte *data, size_t len) {
+    for (size_t p = 1; p < len; p++) {
+        if (memcmp(data, data + p, len - p) == 0) {
+            return p;
+        }
+    }
+    return len;
+}
+
+// true if runs are exactly the maximal runs of RUN_MIN_LEN or more of one
+//  byte in data[0..len), found the slow way
+static bool check_runs(const byte *data, size_t len, const vector<ByteRun> &runs) {
+    vector<ByteRun> expected;
+    for (size_t i = 0; i < len; ) {
+        size_t j = i + 1;
+        while (j < len && data[j] == data[i]) {
+            j++;
+        }
+        if (j - i >= RUN_MIN_LEN) {
+            ByteRun run = {i, j};
+            expected.push_back(run);
+        }
+        i = j;
+    }
+    bool ok = runs.size() == expected.size();
+    for (size_t i = 0; i < runs.size() && ok; i++) {
+        ok = runs[i].start == expected[i].start && runs[i].end == expected[i].end;
+    }
+    return ok;
+}
+
+/*
+ * run_length_encode() must find exactly the long runs, and
+ *  run_length_equal_shifted() agree with memcmp(), on text made of runs of
+ *  random lengths either side of RUN_MIN_LEN. run_length_find_num_copies()
+ *  must find the copies that are exactly the same in the worst case inputs
+ *  and in a mostly blank raster, reading each byte of the raster about once
+ */
+bool run_run_length_test(size_t textlen, size_t copy_size) {
+    bool ok = true;
+    vector<ByteRun> runs;
+    BinString text(textlen);
+    byte *data = text.get_data();
+    unsigned int k = 1;
+    int num_texts = 0;
+    for (int t = 0; t < 200 && ok; t++) {
+        // Runs of 1 to 3 * RUN_MIN_LEN bytes of only a few values, so that
+        //  runs also follow runs of the same length and value
+        for (size_t i = 0; i < textlen; ) {
+            k = k * 1103515245 + 12345;
+            size_t n = min((size_t)(k >> 16) % (3 * RUN_MIN_LEN) + 1, textlen - i);
+            memset(data + i, (k >> 8) % 3, n);
+            i += n;
+        }
+        size_t len = textlen - t % 16;      // not always a whole number of words
+        run_length_encode(data, len, &runs);
+        ok = check_runs(data, len, runs);
+        for (size_t shift = 1; shift < len && ok; shift += 1 + shift / 2) {
+            bool expected = memcmp(data, data + shift, len - shift) == 0;
+            ok = run_length_equal_shifted(data, len, runs, shift) == expected;
+        }
+        // Text that does repeat, with a different byte at the end
+        size_t period = 1 + t * 7 % (len / 2);
+        for (size_t i = period; i < len; i++) {
+            data[i] = data[i - period];
+        }
+        run_length_encode(data, len, &runs);
+        ok = ok && check_runs(data, len, runs) && run_length_equal_shifted(data, len, runs, period);
+        data[len - 1] ^= 0x40;
+        run_length_encode(data, len, &runs);
+        ok = ok && check_runs(data, len, runs) && !run_length_equal_shifted(data, len, runs, period);
+        num_texts++;
+    }
+
+    const int num_copies = 17;
+    const int num_pages = 2 * num_copies;
+    const BinString *inputs[] = {make_raster_copies(num_copies, copy_size), make_blank_copies(num_copies, copy_size),
+                                 make_periodic_copies(num_copies, copy_size), make_copies(num_copies, copy_size),
+                                 make_end_diff_copies(num_copies, copy_size),
+                                 make_raster_copies(num_copies, copy_size)};
+    const int num_inputs = sizeof(inputs) / sizeof(inputs[0]);
+    // The last blank byte of the last copy marked, so the difference is in
+    //  a run
+    byte *first = ((BinString *)inputs[num_inputs - 1])->get_data();
+    byte *last = first + inputs[0]->get_len() - 1;
+    while (last > first && *last != 0) {
+        last--;
+    }
+    *last = 1;
+    vector<int> candidates = get_factors(num_pages);
+    size_t raster_bytes_read = 0;
+    for (int i = 0; i < num_inputs; i++) {
+        const byte *input = inputs[i]->get_data();
+        size_t len = inputs[i]->get_len();
+        int expected = -1;
+        for (unsigned int c = 0; c < candidates.size() && expected < 0; c++) {
+            size_t n = candidates[c];
+            if (n > 1 && len % n == 0 && memcmp(input, input + len / n, len - len / n) == 0) {
+                expected = (int)n;
+            }
+        }
+        ScanStats stats;
+        ok = ok && run_length_find_num_copies(input, len, candidates, &runs, &stats) == expected;
+        if (i == 0) {
+            raster_bytes_read = stats.bytes_read;
+            // The encoding, then the marks and the run ends, in both copies
+            ok = ok && expected == num_copies && stats.bytes_read < 2 * len;
+        }
+        delete inputs[i];
+    }
+
+    cout << "run_length_encode checked " << num_texts << " texts, raster read "
+        << (double)raster_bytes_read / (num_copies * copy_size) << " bytes per byte" << endl;
+    if (!ok) {
+        cerr << "run_run_length_test failed: textlen=" << textlen << ",copy_size=" << copy_size << endl;
+        cerr << "error!!!" << endl;
+    }
+    return ok;
+}
+
+/*
+ * find_period() must agree with naive_period() on every string over a small
+ *  alphabet up to max_len bytes, and must read a bounded number of bytes per
+ *  input byte on the inputs that are worst for the other engines
+ */
+bool run_period_test(int max_len, size_t copy_size) {
+    bool ok = true;
+    byte data[32];
+    int num_strings = 0;
+    for (int len = 1; len <= max_len && len <= (int)sizeof(data); len++) {
+        for (unsigned int bits = 0; bits < (1u << len) && ok; bits++) {
+            for (int i = 0; i < len; i++) {
+                data[i] = (bits >> i) & 1 ? 'b' : 'a';
+            }
+            size_t expected = naive_period(data, len);
+            if (expected > (size_t)len / 2) {
+                expected = len;
+            }
+            ok = find_period(data, len) == expected;
+            num_strings++;
+        }
+    }
+
+    const BinString *inputs[] = {make_copies(17, copy_size), make_blank_copies(17, copy_size),
+                                 make_periodic_copies(17, copy_size), make_end_diff_copies(17, copy_size)};
+    const size_t expected[] = {copy_size, 1, 2, 17 * copy_size};
+    const int num_inputs = sizeof(inputs) / sizeof(inputs[0]);
+    size_t max_bytes_read = 0;
+    for (int i = 0; i < num_inputs; i++) {
+        ScanStats stats;
+        size_t len = inputs[i]->get_len();
+        ok = ok && find_period(inputs[i]->get_data(), len, &stats) == expected[i];
+        // Two maximal suffixes of at most 2*len comparisons each, then the
+        //  final memcmp()
+        ok = ok && stats.bytes_read <= 10 * len;
+        max_bytes_read = max(max_bytes_read, stats.bytes_read / len);
+        delete inputs[i];
+    }
+
+    cout << "find_period checked " << num_strings << " strings, reading at most " << max_bytes_read
+        << " bytes per byte" << endl;
+    if (!ok) {
+        cerr << "run_period_test failed: max_len=" << max_len << ",copy_size=" << copy_size << endl;
+        cerr << "error!!!" << endl;
+    }
+    return ok;
+}
+
+// All matches of pat in text as boyer_moore_all() finds them, by comparing
+//  at every position
+static vector<const byte *> naive_find_all(const byte *text, size_t textlen, const byte *pat, size_t patlen,
+                                           size_t min_gap) {
+    vector<const byte *> matches;
+    size_t p = 0;
+    for (size_t i = 0; i + patlen <= textlen; i++) {
+        if (memcmp(text + i, pat, patlen) == 0) {
+            matches.push_back(text + i);
+            p = max(p + min_gap, i + patlen);
+            i = p - 1;
+        }
+    }
+    return matches;
+}
+
+/*
+ * Every search kernel must find the same matches as comparing at every
+ *  position, for every pattern length up to max_patlen, so across the short,
+ *  Horspool and Boyer-Moore length classes, and Two-Way. The patterns are
+ *  taken from the text, and changed at the start or the end so they match
+ *  less or not at all. They may be longer than the text
+ */
+bool run_search_test(size_t max_patlen, size_t textlen) {
+    const int num_kernels = 4;
+    const SearchKernel kernels[num_kernels] = {KERNEL_BOYER_MOORE, KERNEL_SCALAR, KERNEL_AUTO, KERNEL_SCALAR};
+    const size_t two_way_min_patlens[num_kernels] = {0, TWO_WAY_MIN_PATLEN, TWO_WAY_MIN_PATLEN, 1};
+    const char *kernel_names[num_kernels] = {"boyer-moore", "scalar", "auto", "two-way"};
+    const BinString *texts[] = {make_copies(1, textlen), make_blank_copies(1, textlen),
+                                make_periodic_copies(1, textlen), make_end_diff_copies(2, textlen / 2)};
+    bool ok = true;
+    int num_searches = 0;
+    vector<byte> pat(max_patlen);
+    for (int k = 0; k < num_kernels && ok; k++) {
+        set_search_kernel(kernels[k]);
+        set_two_way_min_patlen(two_way_min_patlens[k]);
+        for (int t = 0; t < 4 && ok; t++) {
+            const byte *text = texts[t]->get_data();
+            size_t len = texts[t]->get_len();
+            for (size_t patlen = 1; patlen <= max_patlen && ok; patlen++) {
+                for (int change = 0; change < 3 && ok; change++) {
+                    for (size_t i = 0; i < patlen; i++) {
+                        pat[i] = text[(len / 3 + i) % len];
+                    }
+                    if (change == 1) {
+                        pat[0] ^= 1;
+                    } else if (change == 2) {
+                        pat[patlen - 1] ^= 1;
+                    }
+                    size_t min_gap = patlen / 2;
+                    vector<const byte *> expected = naive_find_all(text, len, &pat[0], patlen, min_gap);
+                    const byte *first = expected.empty() ? NULL : expected[0];
+                    ok = boyer_moore(text, len, &pat[0], patlen) == first
+                        && boyer_moore_all(text, len, &pat[0], patlen, min_gap) == expected;
+                    if (!ok) {
+                        cerr << "run_search_test failed: kernel=" << kernel_names[k] << ",text=" << t
+                            << ",patlen=" << patlen << ",change=" << change << endl;
+                    }
+                    num_searches++;
+                }
+            }
+        }
+    }
+    set_search_kernel(KERNEL_AUTO);
+    set_two_way_min_patlen(TWO_WAY_MIN_PATLEN);
+    for (int t = 0; t < 4; t++) {
+        delete texts[t];
+    }
+
+    cout << "search kernels checked on " << num_searches << " searches" << endl;
+    if (!ok) {
+        cerr << "error!!!" << endl;
+    }
+    return ok;
+}
+
+/*
+ * boyer_moore_all_mt() must return exactly what boyer_moore_all() does, with
+ *  any number of threads and with gaps between matches both shorter and
+ *  longer than the chunks the threads scan. textlen must be several
+ *  MIN_CHUNK_SIZE for the text to be split at all
+ */
+bool run_mt_search_test(size_t textlen) {
+    const BinString *texts[] = {make_copies(8, textlen / 8), make_blank_copies(1, textlen),
+                                make_periodic_copies(1, textlen), make_raster_copies(8, textlen / 8),
+                                make_end_diff_copies(8, textlen / 8)};
+    const int num_texts = sizeof(texts) / sizeof(texts[0]);
+    const int thread_counts[] = {2, 3, 8};
+    const size_t patlens[] = {16, 1000};
+    bool ok = true;
+    int num_searches = 0;
+    for (int t = 0; t < num_texts && ok; t++) {
+        const byte *text = texts[t]->get_data();
+        size_t len = texts[t]->get_len();
+        for (int p = 0; p < 2 && ok; p++) {
+            size_t patlen = patlens[p];
+            const byte *pat = text + len / 3;
+            // Shorter than a chunk, about a chunk and several chunks
+            const size_t min_gaps[] = {patlen / 2, len / 9, len / 3};
+            for (int g = 0; g < 3 && ok; g++) {
+                vector<const byte *> expected = boyer_moore_all(text, len, pat, patlen, min_gaps[g]);
+                for (int n = 0; n < 3 && ok; n++) {
+                    ok = boyer_moore_all_mt(text, len, pat, patlen, min_gaps[g], thread_counts[n]) == expected;
+                    if (!ok) {
+                        cerr << "run_mt_search_test failed: text=" << t << ",patlen=" << patlen
+                            << ",min_gap=" << min_gaps[g] << ",threads=" << thread_counts[n] << endl;
+                    }
+                    num_searches++;
+                }
+            }
+        }
+    }
+    for (int t = 0; t < num_texts; t++) {
+        delete texts[t];
+    }
+
+    cout << "threaded search checked on " << num_searches << " searches" << endl;
+    if (!ok) {
+        cerr << "error!!!" << endl;
+    }
+    return ok;
+}
+
+/*
+ * find_repeats() must find the same copies with Two-Way as with Boyer-Moore,
+ *  on the inputs that are worst for the search, and with Two-Way must build
+ *  no tables that grow with the pattern for patterns of at least
+ *  TWO_WAY_MIN_PATLEN bytes
+ */
+bool run_two_way_test(size_t copy_size) {
+    const BinString *inputs[] = {make_copies(2, copy_size), make_blank_copies(2, copy_size),
+                                 make_periodic_copies(2, copy_size), make_end_diff_copies(2, copy_size)};
+    const int num_inputs = sizeof(inputs) / sizeof(inputs[0]);
+    bool ok = true;
+    size_t table_bytes[2] = {0, 0};
+    for (int i = 0; i < num_inputs; i++) {
+        int found[2];
+        for (int two_way = 0; two_way < 2; two_way++) {
+            set_two_way_min_patlen(two_way ? TWO_WAY_MIN_PATLEN : 0);
+            ScanStats stats;
+            found[two_way] = find_copies(inputs[i]->get_data(), inputs[i]->get_len(), 2, ENGINE_BOYER_MOORE,
+                                         &stats);
+            table_bytes[two_way] = max(table_bytes[two_way], stats.search.table_bytes);
+        }
+        const byte *data = inputs[i]->get_data();
+        int expected = memcmp(data, data + copy_size, copy_size) == 0 ? 2 : -1;
+        ok = ok && found[0] == expected && found[1] == expected;
+        delete inputs[i];
+    }
+    set_two_way_min_patlen(TWO_WAY_MIN_PATLEN);
+    // Two-Way only has delta1. Boyer-Moore has delta2 and its scratch too
+    ok = ok && table_bytes[1] == ALPHABET_LEN * sizeof(size_t) && table_bytes[0] >= 2 * copy_size * sizeof(size_t);
+
+    cout << "Boyer-Moore tables took " << table_bytes[0] << " bytes, Two-Way " << table_bytes[1] << endl;
+    if (!ok) {
+        cerr << "run_two_way_test failed: copy_size=" << copy_size << endl;
+        cerr << "error!!!" << endl;
+    }
+    return ok;
+}
+
+/*
+ * A BlockReader must hand out the whole file in order, with or without
+ *  O_DIRECT and with block sizes that do not divide the file, and the
+ *  StreamDetector it feeds must find the copies. When the first copies
+ *  differ it must stop reading early
+ */
+bool run_reader_test(bool direct, size_t block_size, int num_copies, size_t copy_size) {
+    const char *path = "inline.copies.tmp";
+    BinString *spool = (BinString *)make_copies(num_copies, copy_size);
+    FILE *f = fopen(path, "wb");
+    if (!f || fwrite(spool->get_data(), 1, spool->get_len(), f) != spool->get_len()) {
+        cerr << "Could not write " << path << endl;
+        if (f) {
+            fclose(f);
+        }
+        delete spool;
+        return false;
+    }
+    fclose(f);
+
+    ReaderConfig config;
+    config.direct = direct;
+    config.block_size = block_size;
+    config.num_buffers = 3;
+    bool ok;
+    bool is_direct;
+    int num_blocks = 0;
+    {
+        BlockReader reader(path, config);
+        ok = reader.is_open() && reader.get_len() == spool->get_len();
+        is_direct = reader.is_direct();
+        size_t pos = 0;
+        size_t len;
+        while (const byte *block = reader.next(&len)) {
+            ok = ok && pos + len <= spool->get_len() && memcmp(block, spool->get_data() + pos, len) == 0;
+            pos += len;
+            num_blocks++;
+        }
+        ok = ok && pos == spool->get_len() && !reader.has_error();
+    }
+    int found_num_copies = stream_find_num_copies(path, num_copies, config);
+    ok = ok && found_num_copies == num_copies;
+
+    // Change the second copy. If num_copies is odd every candidate is ruled
+    //  out by 2/3 of the way through the file. An even one is not ruled out
+    //  until the end
+    f = fopen(path, "r+b");
+    fseek(f, (long)copy_size, SEEK_SET);
+    fputc(spool->get_data()[copy_size] ^ 0x40, f);
+    fclose(f);
+    ScanStats stats;
+    int changed_num_copies = stream_find_num_copies(path, num_copies, config, &stats);
+    ok = ok && changed_num_copies == -1;
+    ok = ok && (num_copies % 2 == 0 || spool->get_len() < 4 * block_size || stats.bytes_read < spool->get_len());
+    remove(path);
+
+    cout << "BlockReader " << (is_direct ? "direct" : "buffered") << ": " << num_blocks << " blocks, found "
+        << found_num_copies << " copies, after a change " << changed_num_copies << " having hashed "
+        << stats.bytes_read << " of " << stats.input_bytes << " bytes" << endl;
+    if (!ok) {
+        cerr << "run_reader_test failed: direct=" << direct << ",block_size=" << block_size
+            << ",num_copies=" << num_copies << ",copy_size=" << copy_size << endl;
+        cerr << "error!!!" << endl;
+    }
+    delete spool;
+    return ok;
+}
+
+static bool write_file(const char *path, const BinString &data) {
+    FILE *f = fopen(path, "wb");
+    bool ok = f && fwrite(data.get_data(), 1, data.get_len(), f) == data.get_len();
+    if (f) {
+        fclose(f);
+    }
+    if (!ok) {
+        cerr << "Could not write " << path << endl;
+    }
+    return ok;
+}
+
+/*
+ * write_single_copy() must write the job control, the first copy with the
+ *  count header after the opening UEL and the job control after the last
+ *  copy, with the copy moved by the kernel on Linux. Exact copies with no
+ *  PJL get a UEL as well. Uncollated copies cannot be written
+ */
+bool run_dedup_test(int num_copies, int pages_per_copy, size_t page_size) {
+    const char *path = "inline.copies.tmp";
+    const char *out_path = "inline.copies.out.tmp";
+    const char *uel = "\x1b%-12345X";
+    char header[64];
+    sprintf(header, DEDUP_COUNT_HEADER, num_copies);
+    bool ok = true;
+    size_t num_in_kernel = 0;
+    size_t num_written = 0;
+    for (int pcl = 0; pcl <= 1; pcl++) {
+        BinString *spool = (BinString *)(pcl ? make_pcl_spool(num_copies, pages_per_copy, page_size)
+                                             : make_copies(num_copies, pages_per_copy * page_size));
+        DetectorConfig config;
+        config.engine = pcl ? ENGINE_PAGE_INDEX : ENGINE_ROLLING_HASH;
+        DetectorResult result = Detector(config).detect(*spool, num_copies * pages_per_copy);
+        const byte *data = spool->get_data();
+        size_t len = spool->get_len();
+        string expected;
+        if (pcl) {
+            expected = string((const char *)data, strlen(uel)) + header
+                + string((const char *)data + strlen(uel), (const char *)data + result.ends[0])
+                + string((const char *)data + result.ends.back(), (const char *)data + len);
+        } else {
+            expected = string(uel) + header + string((const char *)data, len / num_copies);
+        }
+
+        DedupStats stats;
+        ok = ok && write_file(path, *spool) && result.num_copies == num_copies;
+        ok = ok && write_single_copy(path, result, out_path, DedupConfig(), &stats) == (long long)expected.size();
+        {
+            MappedFile output(out_path);
+            ok = ok && output.is_open() && output.get_len() == expected.size()
+                && memcmp(output.get_data(), expected.data(), expected.size()) == 0;
+        }
+#ifdef __linux__
+        ok = ok && stats.bytes_in_kernel + strlen(header) + (pcl ? 0 : strlen(uel)) == stats.bytes_written;
+#endif
+        num_in_kernel += stats.bytes_in_kernel;
+        num_written += stats.bytes_written;
+        DetectorResult single = Detector(config).detect_file(out_path, pages_per_copy);
+        ok = ok && single.num_copies == -1;
+        delete spool;
+    }
+
+    // A count header longer than any fixed size buffer
+    const string comment = "@PJL COMMENT " + string(500, 'x') + "\r\n";
+    const string long_format = comment + DEDUP_COUNT_HEADER;
+    DedupConfig long_config;
+    long_config.count_header = long_format.c_str();
+    const BinString *copies = make_copies(num_copies, pages_per_copy * page_size);
+    DetectorResult copies_result = Detector().detect(*copies, num_copies * pages_per_copy);
+    string expected = string(uel) + comment + header
+        + string((const char *)copies->get_data(), copies->get_len() / num_copies);
+    ok = ok && write_file(path, *copies)
+        && write_single_copy(path, copies_result, out_path, long_config) == (long long)expected.size();
+    {
+        MappedFile output(out_path);
+        ok = ok && output.is_open() && output.get_len() == expected.size()
+            && memcmp(output.get_data(), expected.data(), expected.size()) == 0;
+    }
+
+    // Writing a spool over itself must fail and leave it as it was
+    ok = ok && write_single_copy(path, copies_result, path) == -1;
+    {
+        MappedFile input(path);
+        ok = ok && input.is_open() && input.get_len() == copies->get_len()
+            && memcmp(input.get_data(), copies->get_data(), copies->get_len()) == 0;
+    }
+    delete copies;
+
+    BinString *uncollated = (BinString *)make_pcl_spool(num_copies, pages_per_copy, page_size, false);
+    DetectorConfig config;
+    config.engine = ENGINE_PAGE_INDEX;
+    DetectorResult result = Detector(config).detect(*uncollated, 0);
+    ok = ok && write_file(path, *uncollated);
+    ok = ok && (result.layout != LAYOUT_UNCOLLATED || write_single_copy(path, result, out_path) == -1);
+    delete uncollated;
+    remove(path);
+    remove(out_path);
+
+    cout << "write_single_copy wrote " << num_written << " bytes, " << num_in_kernel << " of them in the kernel"
+        << endl;
+    if (!ok) {
+        cerr << "run_dedup_test failed: num_copies=" << num_copies << ",pages_per_copy=" << pages_per_copy
+            << ",page_size=" << page_size << endl;
+        cerr << "error!!!" << endl;
+    }
+    return ok;
+}
+
+/*
+ * Once a DetectorWorkspace has been used on the inputs, detecting copies in
+ *  them again must not allocate any memory, and must give the same results
+ */
+bool run_alloc_test(CopyEngine engine) {
+    const int num_inputs = 5;
+    const int pages[num_inputs] = {400, 34, 6, 20, 51};
+    const int copies[num_inputs] = {200, 17, 3, 2, 17};
+    const size_t copy_sizes[num_inputs] = {500, 50*1000, 7777, 40, 3001};
+
+    vector<const BinString *> inputs;
+    vector<DetectorResult> expected;
+    DetectorConfig config;
+    config.engine = engine;
+    Detector detector(config);
+    for (int i = 0; i < num_inputs; i++) {
+        BinString *input = (BinString *)make_copies(copies[i], copy_sizes[i]);
+        if (i == num_inputs - 1) {
+            // Not copies
+            input->get_data()[input->get_len() / 2] ^= 1;
+        }
+        inputs.push_back(input);
+        expected.push_back(detector.detect(*input, pages[i]));
+    }
+
+    DetectorWorkspace workspace;
+    DetectorResult result;
+    for (int i = 0; i < num_inputs; i++) {
+        detector.detect(inputs[i]->get_data(), inputs[i]->get_len(), pages[i], &workspace, &result);
+    }
+
+    bool ok = true;
+    size_t num_allocations = 0;
+    for (int i = 0; i < num_inputs; i++) {
+        size_t before = _num_allocations;
+        detector.detect(inputs[i]->get_data(), inputs[i]->get_len(), pages[i], &workspace, &result);
+        num_allocations += _num_allocations - before;
+        ok = ok && result.num_copies == expected[i].num_copies && result.offsets == expected[i].offsets
+            && result.rejected == expected[i].rejected && result.stats.bytes_read == expected[i].stats.bytes_read;
+    }
+    ok = ok && num_allocations == 0;
+
+    cout << "detection with a workspace made " << (int)num_allocations << " allocations" << endl;
+    if (!ok) {
+        cerr << "run_alloc_test failed: engine=" << engine << endl;
+        cerr << "error!!!" << endl;
+    }
+    for (unsigned int i = 0; i < inputs.size(); i++) {
+        delete inputs[i];
+    }
+    return ok;
+}
+
+/*
+ * inline_copies -batch <directory or job list> [num pages] [threads]
+ * A job list has a "<path> <num pages>" line per file. Every file in a
+ *  directory is taken to have num pages
+ */
+int run_batch(int argc, char *argv[]) {
+    int num_pages = argc >= 4 ? atoi(argv[3]) : 0;
+    int num_threads = argc >= 5 ? atoi(argv[4]) : 0;
+
+    vector<BatchJob> jobs;
+    vector<string> paths;
+    if (list_spool_files(argv[2], &paths)) {
+        if (num_pages <= 0) {
+            cerr << "Number of pages needed for a directory" << endl;
+            return 1;
+        }
+        for (unsigned int i = 0; i < paths.size(); i++) {
+            jobs.push_back(BatchJob(paths[i], num_pages));
+        }
+    } else if (!read_job_list(argv[2], &jobs)) {
+        cerr << "Could not read job list " << argv[2] << endl;
+        return 1;
+    }
+
+    BatchResult batch = BatchDetector(DetectorConfig(), num_threads).run(jobs);
+    for (unsigned int i = 0; i < batch.files.size(); i++) {
+        const BatchFileResult &file = batch.files[i];
+        cout << file.path << ": " << (file.ok ? file.result.num_copies : -1) << " copies, "
+            << file.len << " bytes, " << file.latency << " sec" << endl;
+    }
+    cout << batch.files.size() << " files, " << batch.total_bytes / 1e9 << " GB in "
+        << batch.duration << " sec = " << batch.get_gb_per_sec() << " GB/s" << endl;
+    cout << "latency p50 " << batch.get_latency(0.5) << " sec, p90 " << batch.get_latency(0.9)
+        << " sec, p99 " << batch.get_latency(0.99) << " sec, max " << batch.get_latency(1.0) << " sec" << endl;
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+
+    if (argc >= 3 && strcmp(argv[1], "-batch") == 0) {
+        return run_batch(argc, argv);
+    }
+
+    // inline_copies -dedup <spool file> <output file> writes one copy of a
+    //  PCL or PostScript job and a PJL copy count
+    if (argc == 4 && strcmp(argv[1], "-dedup") == 0) {
+        DetectorConfig config;
+        config.engine = ENGINE_PAGE_INDEX;
+        DetectorResult result = Detector(config).detect_file(argv[2], 0);
+        DedupStats stats;
+        if (write_single_copy(argv[2], result, argv[3], DedupConfig(), &stats) < 0) {
+            return 1;
+        }
+        cout << "num_copies = " << result.num_copies << ", wrote " << stats.bytes_written << " bytes, "
+            << stats.bytes_in_kernel << " of them in the kernel" << endl;
+        return 0;
+    }
+
+    // inline_copies <spool file> <num pages> [<index file> <job id>] scans a
+    //  file in place, recording its pages in a fingerprint index
+    if (argc >= 3) {
+        DetectorConfig config;
+        config.log = CopyLog(log_to_cout);
+        FingerprintIndex *index = 0;
+        if (argc >= 4) {
+            index = new FingerprintIndex(argv[3]);
+            if (!index->is_open()) {
+                return 1;
+            }
+            config.fingerprints = index;
+            config.job_id = argc >= 5 ? atoi(argv[4]) : 0;
+        }
+        DetectorResult result = Detector(config).detect_file(argv[1], atoi(argv[2]));
+        delete index;
+        cout << "num_copies = " << result.num_copies
+            << (result.layout == LAYOUT_UNCOLLATED ? " uncollated" : "") << endl;
+        for (unsigned int i = 0; i < result.offsets.size(); i++) {
+            cout << "copy " << i + 1 << " at offset " << result.offsets[i] << endl;
+        }
+        return result.num_copies > 0 ? 0 : 1;
+    }
+
+    bool ok = run_test(4, 2, 40);
+
+    int num_pages = 20;   
+    int num_copies = 2;
+    size_t copy_size = 891;
+   
+    ok = run_test(num_pages, num_copies, copy_size) && ok;
+
+    ok = run_test(40, 20, 50*1000) && ok;
+    ok = run_test(400, 200, 50*1000) && ok;
+    ok = run_test(400, 200, 500*1000) && ok;
+    ok = run_test(4000, 2000, 50*1000) && ok;
+    ok = run_test(400000, 200000, 5*100) && ok;
+    ok = run_test(400000, 200000, 5*1000) && ok;
+    ok = run_test(40, 20, 500*1000) && ok;
+    ok = run_test(34, 17, 500*1000) && ok;
+    ok = run_test(51, 17, 500*1000) && ok;
+    ok = run_test(68, 17, 500*1000) && ok;
+
+    ok = run_near_test(4, 2, 400) && ok;
+    ok = run_near_test(40, 20, 50*1000) && ok;
+    ok = run_near_test(51, 17, 500*1000) && ok;
+
+    ok = run_batch_test(ENGINE_ROLLING_HASH, BATCH_SPLIT_SIZE) && ok;
+    ok = run_batch_test(ENGINE_ROLLING_HASH, 4096) && ok;
+    ok = run_batch_test(ENGINE_SINGLE_PASS, 1000) && ok;
+    ok = run_batch_test(ENGINE_BOYER_MOORE, 4096) && ok;
+
+    ok = run_page_test("pcl", 1, 5, 1000, true) && ok;
+    ok = run_page_test("pcl", 2, 1, 1000, true) && ok;
+    ok = run_page_test("pcl", 6, 7, 3000, true) && ok;
+    ok = run_page_test("pcl", 17, 3, 20*1000, true) && ok;
+    ok = run_page_test("postscript", 1, 5, 1000, true) && ok;
+    ok = run_page_test("postscript", 3, 4, 500, true) && ok;
+    ok = run_page_test("postscript", 10, 12, 5000, true) && ok;
+    ok = run_page_test("pcl", 2, 1, 1000, false) && ok;
+    ok = run_page_test("pcl", 6, 7, 3000, false) && ok;
+    ok = run_page_test("pcl", 4, 6, 2000, false) && ok;
+    ok = run_page_test("postscript", 3, 4, 500, false) && ok;
+    ok = run_page_test("postscript", 10, 12, 5000, false) && ok;
+
+    ok = run_sample_test(400000, 200000, 500) && ok;
+    ok = run_sample_test(68, 17, 5000) && ok;
+    ok = run_sample_test(51, 17, 500*1000) && ok;
+    ok = run_sample_test(720, 12, 100*1000) && ok;
+
+    ok = run_search_test(80, 5000) && ok;
+    ok = run_search_test(8, 7) && ok;
+    ok = run_mt_search_test(9*1024*1024 + 11) && ok;
+    ok = run_two_way_test(TWO_WAY_MIN_PATLEN + 12345) && ok;
+
+    ok = run_period_test(16, 100*1000) && ok;
+    ok = run_period_test(4, 7) && ok;
+
+    ok = run_run_length_test(2000, 100*1000) && ok;
+
+    ok = run_reader_test(false, 100*1000, 20, 50*1000) && ok;
+    ok = run_reader_test(false, 1, 3, 7) && ok;
+    ok = run_reader_test(true, 3*4096, 17, 5003) && ok;
+    ok = run_reader_test(true, READ_BLOCK_SIZE, 2, 10*1000*1000 + 1) && ok;
+
+    ok = run_dedup_test(3, 4, 2000) && ok;
+    ok = run_dedup_test(17, 2, 50*1000) && ok;
+
+    ok = run_index_test(ENGINE_PAGE_INDEX) && ok;
+    ok = run_index_test(ENGINE_ROLLING_HASH) && ok;
+    ok = run_index_test(ENGINE_SINGLE_PASS) && ok;
+    ok = run_index_test(ENGINE_PERIOD) && ok;
+    ok = run_batch_index_test(40, 4) && ok;
+
+    ok = run_alloc_test(ENGINE_ROLLING_HASH) && ok;
+    ok = run_alloc_test(ENGINE_SINGLE_PASS) && ok;
+    ok = run_alloc_test(ENGINE_BOYER_MOORE) && ok;
+    ok = run_alloc_test(ENGINE_PAGE_INDEX) && ok;
+    ok = run_alloc_test(ENGINE_PERIOD) && ok;
+    ok = run_alloc_test(ENGINE_RUN_LENGTH) && ok;
+    set_search_kernel(KERNEL_SCALAR);
+    ok = run_alloc_test(ENGINE_BOYER_MOORE) && ok;
+    set_search_kernel(KERNEL_BOYER_MOORE);
+    ok = run_alloc_test(ENGINE_BOYER_MOORE) && ok;
+    set_two_way_min_patlen(1);
+    ok = run_alloc_test(ENGINE_BOYER_MOORE) && ok;
+    set_two_way_min_patlen(TWO_WAY_MIN_PATLEN);
+    set_search_kernel(KERNEL_AUTO);
+    if (!ok) {
+        return 1;
+    }
+
+    int pages_per_copy = 1;
+    int max_pages_per_copy = 100;
+
+    for (copy_size = 99; copy_size < 1000000; copy_size *= 9) {
+        for (num_copies = 2; num_copies < 100; num_copies++) {
+            num_pages = num_copies * pages_per_copy;
+            if (!run_test(num_pages, num_copies, copy_size)) {
+                 return 1;
+            }
+
+            pages_per_copy += 1;
+            if (pages_per_copy > (int)copy_size/10) {
+                pages_per_copy = (int)copy_size/10;
+            }
+            if (pages_per_copy > max_pages_per_copy) {
+                pages_per_copy = max_pages_per_copy;
+            }
+        }
+    }
+    cout << "************************************************" << endl;
+    return 0;
+}
+
@@ -0,0 +1,188 @@
+#include <memory.h>
+#include <assert.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <string>
+#include "inline_copies.h"
+#include "make_copies.h"
+
+using namespace std;
+
+#define PRIME_1 15485867
+#define PRIME_2 32452843
+
+/*
+ * Test data
+ */
+const BinString *make_copies(int num_copies, size_t copy_size) {
+    size_t num_bytes = num_copies * copy_size;
+    BinString *bin_string = new BinString(num_bytes);
+    byte *data = bin_string->get_data();
+    
+    // Use the high byte. The low byte of this generator repeats every 256
+    //  bytes which gives copies with more copies inside them
+    unsigned int k = 0;
+    for (size_t i = 0; i < copy_size; i++) {
+        data[i] = (k >> 24) % 256;
+        k = (k + PRIME_1) * PRIME_2; 
+    }
+
+    show_data(data, num_bytes, "make_copies");
+    for (int n = 1; n < num_copies; n++) {
+        memcpy(data + n * copy_size, data, copy_size);
+        show_data(data, num_bytes, "updated");
+    }
+   
+    show_data(bin_string->get_data(), bin_string->get_len(), "bin_string");
+    return bin_string;
+}
+
+const BinString *make_blank_copies(int num_copies, size_t copy_size) {
+    size_t num_bytes = num_copies * copy_size;
+    BinString *bin_string = new BinString(num_bytes);
+    memset(bin_string->get_data(), ' ', num_bytes);
+    return bin_string;
+}
+
+const BinString *make_periodic_copies(int num_copies, size_t copy_size) {
+    size_t num_bytes = num_copies * copy_size;
+    BinString *bin_string = new BinString(num_bytes);
+    byte *data = bin_string->get_data();
+    for (size_t i = 0; i < num_bytes; i++) {
+        data[i] = i % 2 ? '2' : '1';
+    }
+    return bin_string;
+}
+
+const BinString *make_end_diff_copies(int num_copies, size_t copy_size) {
+    BinString *bin_string = (BinString *)make_copies(num_copies, copy_size);
+    if (bin_string->get_len() > 0) {
+        bin_string->get_data()[bin_string->get_len() - 1] ^= 0x40;
+    }
+    return bin_string;
+}
+
+const BinString *make_raster_copies(int num_copies, size_t copy_size) {
+    size_t num_bytes = num_copies * copy_size;
+    BinString *bin_string = new BinString(num_bytes);
+    byte *data = bin_string->get_data();
+    memset(data, 0, num_bytes);
+    unsigned int k = 0;
+    for (size_t row = 0; row < copy_size; row += RASTER_ROW_SIZE) {
+        size_t mark = row + (k >> 16) % (RASTER_ROW_SIZE - RASTER_MARK_SIZE);
+        for (size_t i = mark; i < mark + RASTER_MARK_SIZE && i < copy_size; i++) {
+            data[i] = (k >> 24) % 256;
+            k = (k + PRIME_1) * PRIME_2;
+        }
+    }
+    for (int n = 1; n < num_copies; n++) {
+        memcpy(data + n * copy_size, data, copy_size);
+    }
+    return bin_string;
+}
+
+void stamp_copies(byte *data, int num_copies, size_t copy_size) {
+    for (int n = 0; n < num_copies; n++) {
+        char stamp[64];
+        sprintf(stamp, "copy %5d of %5d", n + 1, num_copies);
+        memcpy(data + n * copy_size, stamp, min((size_t)COPY_STAMP_SIZE, copy_size));
+    }
+}
+
+BinString make_copies2(int num_pages, int num_copies, size_t copy_size) {
+    size_t num_bytes = num_copies * copy_size;
+    size_t page_size = num_bytes / num_pages;
+    
+    assert((int)num_bytes > num_pages);
+    assert(num_bytes % num_pages == 0);
+      
+    // Build the data in place so it is not copied a second time
+    BinString bin_string = BinString(num_bytes);
+    byte *data = bin_string.get_data();
+    unsigned int k = 0;
+    for (size_t i = 0; i < page_size; i++) {
+        data[i] = (k >> 24) % 256;
+        k = (k + PRIME_1) * PRIME_2; 
+    }
+
+    show_data(data, num_bytes, "make_copies2");
+    for (int n = 1; n < num_pages; n++) {
+        memcpy(data + n * page_size, data, page_size);
+        show_data(data, num_bytes, "updated");
+    }
+
+    stamp_copies(data, num_copies, copy_size);
+    show_data(data, num_bytes, "updated");
+
+    show_data(bin_string.get_data(), bin_string.get_len(), "bin_string");
+    return bin_string;
+}
+
+// n pseudo-random bytes that depend only on seed
+static string random_bytes(unsigned int seed, size_t n) {
+    string bytes(n, 0);
+    unsigned int k = seed * PRIME_1;
+    for (size_t i = 0; i < n; i++) {
+        bytes[i] = (char)((k >> 24) % 256);
+        k = (k + PRIME_1) * PRIME_2;
+    }
+    return bytes;
+}
+
+static string number(size_t n) {
+    char s[32];
+    sprintf(s, "%u", (unsigned int)n);
+    return s;
+}
+
+static const char *UEL = "\x1b%-12345X";
+
+// Page of the document printed as page i of the spool
+static int document_page(int i, int num_copies, int pages_per_copy, bool collated) {
+    return collated ? i % pages_per_copy : i / num_copies;
+}
+
+const BinString *make_pcl_spool(int num_copies, int pages_per_copy, size_t page_size, bool collated) {
+    string spool = string(UEL) + "@PJL JOB NAME=\"test\"\r\n@PJL ENTER LANGUAGE=PCL\r\n\x1b" "E";
+    for (int i = 0; i < num_copies * pages_per_copy; i++) {
+        int p = document_page(i, num_copies, pages_per_copy, collated);
+        if (collated && i > 0 && p == 0) {
+            spool += string("\x1b" "E") + UEL + "@PJL COMMENT copy " + number(i / pages_per_copy + 1)
+                + "\r\n@PJL ENTER LANGUAGE=PCL\r\n\x1b" "E";
+        }
+        spool += "\x1b&l0OPage " + number(p + 1) + "\r\n\x1b*r1A";
+        // Raster rows of binary data, which has form feeds and escapes in it
+        int num_rows = 1 + p % 3;
+        size_t row_size = (page_size + p * 37) / num_rows + 1;
+        for (int r = 0; r < num_rows; r++) {
+            spool += "\x1b*b" + number(row_size) + "W" + random_bytes(p * 3 + r + 1, row_size);
+        }
+        spool += "\x1b*rB\x0c";
+    }
+    spool += string("\x1b" "E") + UEL + "@PJL EOJ\r\n" + UEL;
+    return new BinString((const byte *)spool.data(), spool.size());
+}
+
+const BinString *make_postscript_spool(int num_copies, int pages_per_copy, size_t page_size,
+                                       bool collated) {
+    int num_pages = num_copies * pages_per_copy;
+    string spool = "%!PS-Adobe-3.0\n%%Pages: " + number(num_pages) + "\n%%EndComments\n"
+        "%%BeginProlog\n/d {def} bind def\n%%EndProlog\n";
+    static const char *HEX = "0123456789abcdef";
+    for (int i = 0; i < num_pages; i++) {
+        int p = document_page(i, num_copies, pages_per_copy, collated);
+        spool += "%%Page: " + number(i + 1) + " " + number(i + 1) + "\ngsave\n<";
+        string bytes = random_bytes(p + 1, (page_size + p * 13) / 2);
+        for (size_t j = 0; j < bytes.size(); j++) {
+            spool += HEX[(byte)bytes[j] >> 4];
+            spool += HEX[(byte)bytes[j] & 15];
+            if (j % 32 == 31) {
+                spool += "\n";
+            }
+        }
+        spool += ">\ngrestore showpage\n";
+    }
+    spool += "%%Trailer\n%%EOF\n";
+    return new BinString((const byte *)spool.data(), spool.size());
+}
@@ -0,0 +1,50 @@
+#ifndef MAKE_COPIES_H
+#define MAKE_COPIES_H
+
+#include "BinString.h"
+
+// Size of the banner stamp_copies() writes at the start of each copy
+#define COPY_STAMP_SIZE 19
+
+// Rows of make_raster_copies() and the bytes marked in each
+#define RASTER_ROW_SIZE 1024
+#define RASTER_MARK_SIZE 64
+
+// num_copies copies of copy_size pseudo-random bytes. Caller deletes
+const BinString *make_copies(int num_copies, size_t copy_size);
+
+// Worst cases named in inline_copies.cpp, each num_copies * copy_size bytes.
+//  Caller deletes
+// All blanks, so every candidate matches everywhere
+const BinString *make_blank_copies(int num_copies, size_t copy_size);
+// "121212...", which a pattern overlaps itself in every other byte
+const BinString *make_periodic_copies(int num_copies, size_t copy_size);
+// make_copies() with the last byte changed, so every candidate fails at the
+//  very end
+const BinString *make_end_diff_copies(int num_copies, size_t copy_size);
+// A mostly blank raster page: zero bytes with RASTER_MARK_SIZE pseudo-random
+//  bytes somewhere in each RASTER_ROW_SIZE byte row
+const BinString *make_raster_copies(int num_copies, size_t copy_size);
+
+// num_copies copies made of num_pages identical pages, each copy stamped
+//  with stamp_copies()
+BinString make_copies2(int num_pages, int num_copies, size_t copy_size);
+
+// Write a "copy n of N" banner at the start of each copy, as a spooler does.
+//  The copies then differ in their first COPY_STAMP_SIZE bytes
+void stamp_copies(byte *data, int num_copies, size_t copy_size);
+
+// A PJL/PCL job with num_copies copies of a pages_per_copy page document.
+//  Pages are about page_size bytes and all different sizes. They have
+//  raster data with form feeds and escapes in it. Collated copies have PJL
+//  between them that says which copy it is. Uncollated copies print each
+//  page num_copies times in a row, as a driver does. Caller deletes
+const BinString *make_pcl_spool(int num_copies, int pages_per_copy, size_t page_size, bool collated = true);
+
+// A PostScript document with num_copies copies, collated or not as in
+//  make_pcl_spool(). The %%Page: comments number the pages
+//  1..num_copies*pages_per_copy. Caller deletes
+const BinString *make_postscript_spool(int num_copies, int pages_per_copy, size_t page_size,
+                                       bool collated = true);
+
+#endif
@@ -0,0 +1,89 @@
+#include <string.h>
+#include <algorithm>
+#include "near_duplicate.h"
+
+using namespace std;
+
+#define MISMATCH_BLOCK 64
+
+// Index of first byte where a and b differ or n if they don't.
+// Equal blocks are skipped with memcmp
+static size_t mismatch(const byte *a, const byte *b, size_t n) {
+    size_t i = 0;
+    while (i + MISMATCH_BLOCK <= n && memcmp(a + i, b + i, MISMATCH_BLOCK) == 0) {
+        i += MISMATCH_BLOCK;
+    }
+    while (i < n && a[i] == b[i]) {
+        i++;
+    }
+    return i;
+}
+
+bool diff_copy(const byte *data, size_t len, int num_copies, int copy_num,
+               const NearDuplicateOptions &options, vector<DiffRegion> *regions) {
+    size_t copy_size = len / num_copies;
+    const byte *a = data;
+    const byte *b = data + copy_num * copy_size;
+    size_t suffix_start = copy_size - min(options.max_suffix, copy_size);
+
+    int num_regions = 0;
+    size_t region_bytes = 0;
+    size_t p = 0;
+    while (p < copy_size) {
+        p += mismatch(a + p, b + p, copy_size - p);
+        if (p >= copy_size) {
+            break;
+        }
+        // Extend the region until there are merge_gap equal bytes in a row
+        size_t start = p;
+        size_t last = p;
+        for (p++; p < copy_size && p - last <= options.merge_gap; p++) {
+            if (a[p] != b[p]) {
+                last = p;
+            }
+        }
+        DiffRegion region;
+        region.copy = copy_num;
+        region.offset = start;
+        region.len = last + 1 - start;
+
+        bool in_prefix = last < options.max_prefix;
+        bool in_suffix = start >= suffix_start;
+        if (!in_prefix && !in_suffix) {
+            num_regions++;
+            region_bytes += region.len;
+            if (num_regions > options.max_regions || region_bytes > options.max_region_bytes) {
+                return false;
+            }
+        }
+        regions->push_back(region);
+        p = last + 1;
+    }
+    return true;
+}
+
+int near_find_num_copies(const byte *data, size_t len, vector<int> numcopies_candidates,
+                         const NearDuplicateOptions &options, vector<DiffRegion> *regions,
+                         ScanStats *stats) {
+    for (unsigned int i = 0; i < numcopies_candidates.size(); i++) {
+        int num_copies = numcopies_candidates[i];
+        if (num_copies <= 1 || len % num_copies != 0) {
+            continue;
+        }
+        size_t copy_size = len / num_copies;
+        vector<DiffRegion> copy_regions;
+        bool match = true;
+        for (int n = 1; n < num_copies && match; n++) {
+            match = diff_copy(data, len, num_copies, n, options, &copy_regions);
+            if (stats) {
+                stats->bytes_read += 2 * copy_size;
+            }
+        }
+        if (match) {
+            *regions = copy_regions;
+            return num_copies;
+        }
+    }
+    regions->clear();
+    return -1;
+}
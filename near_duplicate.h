@@ -0,0 +1,50 @@
+#ifndef NEAR_DUPLICATE_H
+#define NEAR_DUPLICATE_H
+
+#include <vector>
+#include "BinString.h"
+#include "inline_copies.h"
+
+// How much each copy may differ from the first copy and still count as a copy.
+// Real spools stamp "copy 3 of 5" or a job banner into each copy.
+struct NearDuplicateOptions {
+    size_t max_prefix;          // differences in the first max_prefix bytes of a copy are allowed
+    size_t max_suffix;          // so are differences in the last max_suffix bytes
+    int max_regions;            // number of other differing regions allowed per copy
+    size_t max_region_bytes;    // total size of those regions per copy
+    size_t merge_gap;           // differences closer than this form one region
+
+    NearDuplicateOptions():
+        max_prefix(0),
+        max_suffix(0),
+        max_regions(0),
+        max_region_bytes(0),
+        merge_gap(16)
+    {}
+};
+
+// A region of a copy that differs from the first copy
+struct DiffRegion {
+    int copy;           // copy number, 1 .. num_copies-1
+    size_t offset;      // offset within the copy
+    size_t len;
+};
+
+/*
+ * Near-duplicate version of find_copies().
+ * Copies are compared with the first copy in a single linear pass per
+ *  candidate and the differing regions are collected. A candidate is rejected
+ *  as soon as its differences exceed the limits in options.
+ * Returns the largest number of copies found or -1. The differing regions of
+ *  the copies found are returned in regions.
+ */
+int near_find_num_copies(const byte *data, size_t len, std::vector<int> numcopies_candidates,
+                         const NearDuplicateOptions &options, std::vector<DiffRegion> *regions,
+                         ScanStats *stats = 0);
+
+// Differing regions of copy copy_num of num_copies copies in data or false if
+//  they exceed the limits in options
+bool diff_copy(const byte *data, size_t len, int num_copies, int copy_num,
+               const NearDuplicateOptions &options, std::vector<DiffRegion> *regions);
+
+#endif
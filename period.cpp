@@ -0,0 +1,116 @@
+#include <stddef.h>
+#include <string.h>
+#include "period.h"
+
+using namespace std;
+
+size_t common_prefix(const byte *a, const byte *b, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        unsigned long long wa, wb;
+        memcpy(&wa, a + i, 8);
+        memcpy(&wb, b + i, 8);
+        if (wa != wb) {
+            break;
+        }
+    }
+    while (i < n && a[i] == b[i]) {
+        i++;
+    }
+    return i;
+}
+
+/*
+ * Start - 1 of the maximal suffix of x[0..n) for the byte order given by
+ *  reverse, and its period p (Crochemore-Perrin). ms = (size_t)-1 stands
+ *  for the whole of x.
+ * x[ms+1..j+k) has period p and j - ms is a multiple of p, so comparing
+ *  x[j+k] with x[ms+k] is comparing it with x[j+k-p]. That lets all the
+ *  matching periods be compared in one common_prefix() call rather than one
+ *  byte at a time, which is what makes copies, blank pages and short
+ *  repeats fast
+ */
+static size_t max_suffix(const byte *x, size_t n, bool reverse, size_t *period, size_t *num_compared) {
+    size_t ms = (size_t)-1;
+    size_t j = 0;
+    size_t k = 1;
+    size_t p = 1;
+    while (j + k < n) {
+        const byte *a = x + (j + k);
+        size_t run = n - j - k;
+        // Most comparisons in data that is not repetitive fail at once
+        size_t same = a[0] == a[-(ptrdiff_t)p] ? common_prefix(a, a - p, run) : 0;
+        *num_compared += 2 * same;
+        if (same == run) {
+            break;
+        }
+        // Skip the whole periods that matched. Usually there are none, and
+        //  then the divisions are not worth doing
+        k += same;
+        if (k > p) {
+            size_t matched = k - 1;
+            j += matched / p * p;
+            k = matched % p + 1;
+        }
+        *num_compared += 2;
+        byte next = x[j + k];
+        byte prev = x[j + k - p];
+        if (reverse ? next > prev : next < prev) {
+            j += k;
+            k = 1;
+            p = j - ms;
+        } else {
+            ms = j++;
+            k = p = 1;
+        }
+    }
+    *period = p;
+    return ms;
+}
+
+size_t critical_factorization(const byte *x, size_t n, size_t *period, ScanStats *stats) {
+    size_t num_compared = 0;
+    size_t period_fwd, period_rev;
+    size_t ms_fwd = max_suffix(x, n, false, &period_fwd, &num_compared);
+    size_t ms_rev = max_suffix(x, n, true, &period_rev, &num_compared);
+    if (stats) {
+        stats->bytes_read += num_compared;
+    }
+    // The later of the two suffixes is a critical position
+    if (ms_rev + 1 < ms_fwd + 1) {
+        *period = period_fwd;
+        return ms_fwd + 1;
+    }
+    *period = period_rev;
+    return ms_rev + 1;
+}
+
+size_t find_period(const byte *data, size_t len, ScanStats *stats) {
+    if (len < 2) {
+        return len;
+    }
+    size_t period;
+    size_t l = critical_factorization(data, len, &period, stats);
+    // If the left part is a suffix of the first period of the right part,
+    //  period is the period of all of data. Otherwise the period is more
+    //  than max(l, len - l) >= len/2
+    if (period > len / 2) {
+        return len;
+    }
+    if (stats) {
+        stats->bytes_read += 2 * l;
+    }
+    return memcmp(data, data + period, l) == 0 ? period : len;
+}
+
+int period_find_num_copies(const byte *data, size_t len, const vector<int> &numcopies_candidates,
+                           ScanStats *stats) {
+    size_t period = find_period(data, len, stats);
+    for (unsigned int i = 0; i < numcopies_candidates.size(); i++) {
+        size_t num_copies = numcopies_candidates[i];
+        if (num_copies > 1 && len % num_copies == 0 && (len / num_copies) % period == 0) {
+            return (int)num_copies;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,35 @@
+#ifndef PERIOD_H
+#define PERIOD_H
+
+#include <vector>
+#include "BinString.h"
+#include "inline_copies.h"
+
+// Number of bytes at the start of a[0..n) and b[0..n) that are the same,
+//  compared 8 at a time
+size_t common_prefix(const byte *a, const byte *b, size_t n);
+
+// Critical factorization of x[0..n) (Crochemore-Perrin): x = x[0..l) x[l..n)
+//  where l is computed from the maximal suffixes of x for both byte orders.
+//  Returns l and sets *period to the period of x[l..n). The constant memory
+//  preprocessing step of the Two-Way string matcher
+size_t critical_factorization(const byte *x, size_t n, size_t *period, ScanStats *stats = 0);
+
+// Smallest period p of data[0..len), so data[i] == data[i + p] for all i.
+//  Exact when p <= len/2. Otherwise the result is len, as then no period
+//  less than len divides len. O(len) time and O(1) memory
+size_t find_period(const byte *data, size_t len, ScanStats *stats = 0);
+
+/*
+ * Period alternative to find_num_copies().
+ * data holds K exact copies iff len/K is a period of data, and the periods
+ *  that divide len are the multiples of the smallest period. So one
+ *  find_period() answers every candidate: no Boyer-Moore tables, no
+ *  fingerprints and no memory that depends on len. Like the hash engines it
+ *  needs copies to be exactly the same.
+ * Returns the largest candidate that matches or -1 if there are none.
+ */
+int period_find_num_copies(const byte *data, size_t len, const std::vector<int> &numcopies_candidates,
+                           ScanStats *stats = 0);
+
+#endif
@@ -0,0 +1,114 @@
+#include <stddef.h>
+#include <string.h>
+#include <algorithm>
+#include "run_length.h"
+
+using namespace std;
+
+typedef unsigned long long word_t;
+
+// A word with every byte 1, so b * ONES has every byte b
+static const word_t ONES = 0x0101010101010101ULL;
+
+static inline word_t load_word(const byte *p) {
+    word_t w;
+    memcpy(&w, p, 8);
+    return w;
+}
+
+/*
+ * Only the words at multiples of 8 are tested for being all one byte. A
+ *  run of RUN_MIN_LEN >= 15 bytes must cover one of them, so no run is
+ *  missed, and text with no runs costs one load and compare per 8 bytes.
+ *  A word that is all one byte is grown back to the start of its run and
+ *  forward to the end, and the search goes on from there
+ */
+void run_length_encode(const byte *data, size_t len, vector<ByteRun> *runs, ScanStats *stats) {
+    runs->clear();
+    size_t prev_end = 0;        // runs do not overlap
+    size_t w = 0;
+    while (w + 8 <= len) {
+        word_t x = load_word(data + w);
+        if (x != (x & 0xff) * ONES) {
+            w += 8;
+            continue;
+        }
+        byte value = data[w];
+        size_t start = w;
+        while (start > prev_end && data[start - 1] == value) {
+            start--;
+        }
+        size_t end = w + 8;
+        while (end + 8 <= len && load_word(data + end) == x) {
+            end += 8;
+        }
+        while (end < len && data[end] == value) {
+            end++;
+        }
+        if (end - start >= RUN_MIN_LEN) {
+            ByteRun run = {start, end};
+            runs->push_back(run);
+            prev_end = end;
+        }
+        // The word that holds end has a byte of this run and one that is
+        //  not, so it cannot start another run
+        w = end / 8 * 8 + 8;
+    }
+    if (stats) {
+        stats->bytes_read += len;
+    }
+}
+
+bool run_length_equal_shifted(const byte *data, size_t len, const vector<ByteRun> &runs, size_t shift,
+                              ScanStats *stats) {
+    if (shift >= len) {
+        return true;
+    }
+    // Compare data[x..) with data[x+shift..) a stretch at a time. A stretch
+    //  ends where either side goes into or out of a run. a and b are the
+    //  first runs that end after x and after x + shift
+    size_t n = len - shift;
+    size_t num_runs = runs.size();
+    size_t a = 0;
+    size_t b = 0;
+    size_t num_compared = 0;
+    bool equal = true;
+    for (size_t x = 0; x < n && equal; ) {
+        while (a < num_runs && runs[a].end <= x) {
+            a++;
+        }
+        while (b < num_runs && runs[b].end <= x + shift) {
+            b++;
+        }
+        bool in_a = a < num_runs && runs[a].start <= x;
+        bool in_b = b < num_runs && runs[b].start <= x + shift;
+        size_t next_a = a < num_runs ? (in_a ? runs[a].end : runs[a].start) : len;
+        size_t next_b = b < num_runs ? (in_b ? runs[b].end : runs[b].start) : len;
+        size_t step = min(min(next_a - x, next_b - (x + shift)), n - x);
+        if (in_a && in_b) {
+            equal = data[x] == data[x + shift];
+            num_compared++;
+        } else {
+            equal = memcmp(data + x, data + x + shift, step) == 0;
+            num_compared += step;
+        }
+        x += step;
+    }
+    if (stats) {
+        stats->bytes_read += 2 * num_compared;
+    }
+    return equal;
+}
+
+int run_length_find_num_copies(const byte *data, size_t len, const vector<int> &numcopies_candidates,
+                               vector<ByteRun> *runs, ScanStats *stats) {
+    run_length_encode(data, len, runs, stats);
+    for (unsigned int i = 0; i < numcopies_candidates.size(); i++) {
+        size_t num_copies = numcopies_candidates[i];
+        if (num_copies > 1 && len % num_copies == 0
+            && run_length_equal_shifted(data, len, *runs, len / num_copies, stats)) {
+            return (int)num_copies;
+        }
+    }
+    return -1;
+}
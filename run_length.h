@@ -0,0 +1,48 @@
+#ifndef RUN_LENGTH_H
+#define RUN_LENGTH_H
+
+#include <vector>
+#include "BinString.h"
+#include "inline_copies.h"
+
+// Shortest run of one byte value that run_length_encode() records. Every run
+//  this long covers a whole 8 byte word at an offset that is a multiple of 8,
+//  which is how runs are found without looking at each byte
+#define RUN_MIN_LEN 32
+
+// data[start..end) are all the same byte
+struct ByteRun {
+    size_t start;
+    size_t end;
+};
+
+// The runs of RUN_MIN_LEN or more of one byte in data[0..len), in order, into
+//  runs, which is cleared first. Reads data once, 8 bytes at a time
+void run_length_encode(const byte *data, size_t len, std::vector<ByteRun> *runs, ScanStats *stats = 0);
+
+// true if data[0..len-shift) == data[shift..len). runs, from
+//  run_length_encode(), are compared a run at a time. Only the bytes where
+//  either side is not in a run are compared one by one
+bool run_length_equal_shifted(const byte *data, size_t len, const std::vector<ByteRun> &runs, size_t shift,
+                              ScanStats *stats = 0);
+
+/*
+ * Run-length alternative to find_num_copies() for raster jobs that are
+ *  mostly blank. The blank regions are where Boyer-Moore is slowest: every
+ *  candidate matches everywhere, scan_text() compares backwards over the
+ *  whole pattern and make_delta2() finds every suffix is a prefix.
+ * One pass records the long runs of one byte. data then holds K copies iff
+ *  it equals itself shifted by len/K, and that is checked in run space: two
+ *  runs compare in one step whatever their length. So a candidate costs the
+ *  number of runs plus the bytes outside them, not len. A candidate that
+ *  does not divide len is skipped, the others are tried in the order given
+ *  and the first whose shift matches wins. So unlike
+ *  period_find_num_copies() a job with few runs can pay a comparison of up
+ *  to len bytes for each candidate that fails.
+ * Returns what period_find_num_copies() would. runs is scratch space that
+ *  is reused, so that no memory is allocated once it has grown.
+ */
+int run_length_find_num_copies(const byte *data, size_t len, const std::vector<int> &numcopies_candidates,
+                               std::vector<ByteRun> *runs, ScanStats *stats = 0);
+
+#endif
@@ -0,0 +1,72 @@
+#include <string.h>
+#include <algorithm>
+#include "sample_filter.h"
+
+using namespace std;
+
+// xorshift64*. Good enough to spread the samples, and seeded so that the
+//  same input gets the same samples
+static unsigned long long next_random(unsigned long long *state) {
+    unsigned long long x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+// true if copy k of a copy_size copy matches the first copy at ofs
+static bool same_window(const byte *data, size_t copy_size, size_t k, size_t ofs, size_t window,
+                        ScanStats *stats) {
+    if (stats) {
+        stats->bytes_read += 2 * window;
+    }
+    return memcmp(data + ofs, data + k * copy_size + ofs, window) == 0;
+}
+
+// true if no sampled window of the num_copies copies in data[0..len) differs
+static bool sample_copies(const byte *data, size_t len, size_t num_copies, size_t budget, ScanStats *stats) {
+    size_t copy_size = len / num_copies;
+    size_t window = min((size_t)SAMPLE_WINDOW, copy_size);
+    size_t last = num_copies - 1;
+
+    // Job headers and trailers are where copies most often differ
+    if (!same_window(data, copy_size, last, 0, window, stats) ||
+        !same_window(data, copy_size, last, copy_size - window, window, stats)) {
+        return false;
+    }
+
+    unsigned long long state = (len * 0x9E3779B97F4A7C15ULL) ^ num_copies;
+    state = state ? state : 1;
+    size_t num_offsets = copy_size - window + 1;
+    // No more windows than there are in a copy, so small inputs are not read
+    //  many times over
+    budget = min(budget, copy_size / window);
+    for (size_t i = 0; i < budget; i++) {
+        unsigned long long r = next_random(&state);
+        size_t ofs = (size_t)(r % num_offsets);
+        size_t k = 1 + (size_t)((r >> 32) % last);
+        if (!same_window(data, copy_size, k, ofs, window, stats)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t sample_filter_candidates(const byte *data, size_t len, vector<int> *candidates, size_t budget,
+                                ScanStats *stats) {
+    size_t num_left = 0;
+    for (size_t i = 0; i < candidates->size(); i++) {
+        int num_copies = (*candidates)[i];
+        // Candidates that cannot be exactly aligned copies are left to the
+        //  full check to reject
+        bool keep = num_copies < 2 || len % num_copies != 0 ||
+                    sample_copies(data, len, num_copies, budget, stats);
+        if (keep) {
+            (*candidates)[num_left++] = num_copies;
+        }
+    }
+    size_t num_removed = candidates->size() - num_left;
+    candidates->resize(num_left);
+    return num_removed;
+}
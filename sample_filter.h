@@ -0,0 +1,37 @@
+#ifndef SAMPLE_FILTER_H
+#define SAMPLE_FILTER_H
+
+#include <vector>
+#include "BinString.h"
+#include "inline_copies.h"
+
+// Windows compared per candidate by default, and their length. At most
+//  2 * SAMPLE_BUDGET * SAMPLE_WINDOW = 8 KB is read per candidate
+#define SAMPLE_BUDGET 256
+#define SAMPLE_WINDOW 16
+
+/*
+ * Cheap pre-filter for the candidate numbers of copies.
+ * For each candidate K, budget windows of SAMPLE_WINDOW bytes at random
+ *  offsets in the first copy are compared with the same offsets in randomly
+ *  chosen other copies, plus the first and last window of the last copy.
+ *  Small copies get at most one window per SAMPLE_WINDOW bytes. A
+ *  candidate is removed at the first window that differs, so a wrong K
+ *  usually costs a few dozen bytes instead of a full scan.
+ * The filter is one-sided: exactly aligned copies always pass, so it never
+ *  removes a candidate that find_num_copies() or the hash engines would
+ *  accept with no copy header. A wrong K passes if every window it compares
+ *  happens to match. If a fraction f of the windows of its copies differ
+ *  from the first copy, that happens with probability (1-f)^budget: 1.8%
+ *  for one differing window in 64 with the default budget and practically
+ *  never for unrelated data, where f is close to 1. Those
+ *  are rejected by the full check that follows, so they cost time, never a
+ *  wrong answer.
+ * The offsets depend only on len and K, so the result is repeatable.
+ * candidates is filtered in place and keeps its order. Returns the number
+ *  removed
+ */
+size_t sample_filter_candidates(const byte *data, size_t len, std::vector<int> *candidates,
+                                size_t budget = SAMPLE_BUDGET, ScanStats *stats = 0);
+
+#endif
@@ -0,0 +1,133 @@
+#include <string.h>
+#include <assert.h>
+#include "boyer_moore.h"
+#include "sampled_anchor.h"
+
+using namespace std;
+
+#define MAX_PROBE_LEN 256
+// How many windows choose_probe() tries before giving up
+#define MAX_PROBE_TRIES 64
+
+// true if pat[0..patlen) has a nontrivial border, i.e. a proper prefix that
+//  is also a suffix. This is the last entry of the KMP failure function
+static bool has_border(const byte *pat, size_t patlen) {
+    size_t pi[MAX_PROBE_LEN];
+    pi[0] = 0;
+    size_t k = 0;
+    for (size_t i = 1; i < patlen; i++) {
+        while (k > 0 && pat[i] != pat[k]) {
+            k = pi[k - 1];
+        }
+        if (pat[i] == pat[k]) {
+            k++;
+        }
+        pi[i] = k;
+    }
+    return pi[patlen - 1] > 0;
+}
+
+bool choose_probe(const byte *data, size_t begin, size_t end, size_t probe_len, size_t *probe_ofs) {
+    assert(probe_len <= MAX_PROBE_LEN);
+    if (probe_len == 0 || end - begin < probe_len) {
+        return false;
+    }
+    // Try windows from the middle of the range forwards, then from the start.
+    //  Like find_repeats() this prefers the middle of the copy
+    size_t last = end - probe_len;
+    size_t mid = begin + (last - begin) / 2;
+    size_t ofs = mid;
+    for (int i = 0; i < MAX_PROBE_TRIES; i++) {
+        if (!has_border(data + ofs, probe_len)) {
+            *probe_ofs = ofs;
+            return true;
+        }
+        ofs += probe_len;
+        if (ofs > last) {
+            ofs = begin;
+        }
+    }
+    return false;
+}
+
+vector<size_t> find_repeats_sampled(const byte *data, size_t len, int num_copies, size_t tolerance,
+                                    size_t *repeat_len, ScanStats *stats) {
+    size_t copy_size = len / num_copies;
+    *repeat_len = copy_size;
+
+    vector<size_t> offsets;
+    offsets.push_back(0);
+    if (num_copies <= 1 || len % num_copies != 0) {
+        return offsets;
+    }
+
+    size_t probe_len = ANCHOR_PROBE_LEN;
+    size_t probe_ofs = 0;
+    bool anchored = copy_size >= 4 * probe_len && choose_probe(data, 0, copy_size, probe_len, &probe_ofs);
+
+    if (!anchored) {
+        // Short copies, or degenerate ones such as all blanks where every probe
+        //  overlaps itself. Compare the copies directly
+        for (int i = 1; i < num_copies; i++) {
+            if (stats) {
+                stats->bytes_read += 2 * copy_size;
+            }
+            if (memcmp(data, data + i * copy_size, copy_size) != 0) {
+                break;
+            }
+            offsets.push_back(i * copy_size);
+        }
+        return offsets;
+    }
+
+    // Look for the probe near the same offset in each copy. Most wrong
+    //  candidates are rejected here after reading a few bytes per copy
+    CompiledPattern probe(data + probe_ofs, probe_len);
+    vector<size_t> anchors;
+    anchors.push_back(probe_ofs);
+    for (int i = 1; i < num_copies; i++) {
+        size_t expected = i * copy_size + probe_ofs;
+        size_t begin = expected > tolerance ? expected - tolerance : 0;
+        size_t end = min(expected + probe_len + tolerance, len);
+        const byte *m = probe.find(data + begin, end - begin);
+        if (stats) {
+            stats->bytes_read += end - begin;
+        }
+        if (!m) {
+            break;
+        }
+        anchors.push_back(m - data);
+    }
+
+    // Grow the matches from the anchors to whole copies with a plain comparison
+    for (unsigned int i = 1; i < anchors.size(); i++) {
+        if (anchors[i] < probe_ofs) {
+            break;
+        }
+        size_t start = anchors[i] - probe_ofs;
+        if (start + copy_size > len) {
+            break;
+        }
+        if (stats) {
+            stats->bytes_read += 2 * copy_size;
+        }
+        if (memcmp(data, data + start, copy_size) != 0) {
+            break;
+        }
+        offsets.push_back(start);
+    }
+    return offsets;
+}
+
+int anchor_find_num_copies(const byte *data, size_t len, vector<int> numcopies_candidates, size_t tolerance,
+                           ScanStats *stats) {
+    for (unsigned int i = 0; i < numcopies_candidates.size(); i++) {
+        int num_copies = numcopies_candidates[i];
+        size_t repeat_len;
+        vector<size_t> offsets = find_repeats_sampled(data, len, num_copies, tolerance, &repeat_len, stats);
+        if ((int)offsets.size() == num_copies) {
+            return num_copies;
+        }
+    }
+    return -1;
+}
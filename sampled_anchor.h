@@ -0,0 +1,35 @@
+#ifndef SAMPLED_ANCHOR_H
+#define SAMPLED_ANCHOR_H
+
+#include <vector>
+#include "BinString.h"
+#include "inline_copies.h"
+
+// Length of the probe patterns used by the sampled-anchor search
+#define ANCHOR_PROBE_LEN 32
+
+// Offset of a probe_len byte window in data[begin..end) that has no
+//  nontrivial border (a prefix that is also a suffix, as in "121212"), so two
+//  occurrences of it can never overlap. Returns false if there is none, e.g.
+//  if the data is all blanks
+bool choose_probe(const byte *data, size_t begin, size_t end, size_t probe_len, size_t *probe_ofs);
+
+/*
+ * Sampled-anchor alternative to find_repeats().
+ * Instead of searching for a whole copy, search each candidate copy range for a
+ *  short non-self-overlapping probe taken from the first copy. The probe must
+ *  be found within tolerance bytes of the same offset in every copy. Only
+ *  then are the copies compared in full.
+ * Returns the offsets of the copies that match the first copy, stopping at the
+ *  first one that does not. So num_copies offsets are returned iff data holds
+ *  num_copies copies (exactly aligned if tolerance is 0).
+ */
+std::vector<size_t> find_repeats_sampled(const byte *data, size_t len, int num_copies, size_t tolerance,
+                                         size_t *repeat_len, ScanStats *stats = 0);
+
+// Largest of numcopies_candidates for which find_repeats_sampled() finds all
+//  the copies, or -1
+int anchor_find_num_copies(const byte *data, size_t len, std::vector<int> numcopies_candidates, size_t tolerance,
+                           ScanStats *stats = 0);
+
+#endif
@@ -0,0 +1,186 @@
+#include <string.h>
+#include "search_simd.h"
+
+/*
+ * SIMD search kernels
+ *
+ * For 16 (SSE2) or 32 (AVX2) candidate positions at a time compare the first
+ *  and last bytes of the pattern with the text. Only positions where both
+ *  match are checked with memcmp. On high entropy data such as compressed
+ *  rasters this touches each text byte about twice with wide loads instead
+ *  of doing a table lookup per byte.
+ *
+ * Boyer-Moore skips up to patlen bytes per step so it overtakes these kernels
+ *  for long patterns. SIMD_MAX_PATLEN is the crossover.
+ */
+#define SIMD_MAX_PATLEN 64
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define HAVE_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#else
+#define HAVE_X86 0
+#endif
+
+#ifdef _MSC_VER
+#define TARGET_AVX2
+static inline int ctz(unsigned int x) {
+    unsigned long i;
+    _BitScanForward(&i, x);
+    return (int)i;
+}
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+static inline int ctz(unsigned int x) {
+    return __builtin_ctz(x);
+}
+#endif
+
+// Check the candidate positions i+bit for each set bit of mask
+static inline const byte *check_mask(const byte *text, size_t i, unsigned int mask, const byte *pat, size_t patlen) {
+    while (mask) {
+        const byte *p = text + i + ctz(mask);
+        if (memcmp(p + 1, pat + 1, patlen - 2) == 0) {
+            return p;
+        }
+        mask &= mask - 1;
+    }
+    return NULL;
+}
+
+// Positions from i on that the vector loops did not cover
+static const byte *search_tail(const byte *text, size_t textlen, const byte *pat, size_t patlen, size_t i) {
+    for (; i + patlen <= textlen; i++) {
+        if (text[i] == pat[0] && text[i + patlen - 1] == pat[patlen - 1]
+            && memcmp(text + i + 1, pat + 1, patlen - 2) == 0) {
+            return text + i;
+        }
+    }
+    return NULL;
+}
+
+#if HAVE_X86
+
+const byte *search_sse2(const byte *text, size_t textlen, const byte *pat, size_t patlen) {
+    if (patlen < 2) {
+        return patlen ? (const byte *)memchr(text, pat[0], textlen) : text;
+    }
+    const __m128i first = _mm_set1_epi8((char)pat[0]);
+    const __m128i last = _mm_set1_epi8((char)pat[patlen - 1]);
+
+    size_t i = 0;
+    for (; i + patlen - 1 + 16 <= textlen; i += 16) {
+        __m128i b0 = _mm_loadu_si128((const __m128i *)(text + i));
+        __m128i b1 = _mm_loadu_si128((const __m128i *)(text + i + patlen - 1));
+        __m128i eq = _mm_and_si128(_mm_cmpeq_epi8(b0, first), _mm_cmpeq_epi8(b1, last));
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(eq);
+        if (mask) {
+            const byte *p = check_mask(text, i, mask, pat, patlen);
+            if (p) {
+                return p;
+            }
+        }
+    }
+    return search_tail(text, textlen, pat, patlen, i);
+}
+
+TARGET_AVX2
+const byte *search_avx2(const byte *text, size_t textlen, const byte *pat, size_t patlen) {
+    if (patlen < 2) {
+        return patlen ? (const byte *)memchr(text, pat[0], textlen) : text;
+    }
+    const __m256i first = _mm256_set1_epi8((char)pat[0]);
+    const __m256i last = _mm256_set1_epi8((char)pat[patlen - 1]);
+
+    size_t i = 0;
+    for (; i + patlen - 1 + 32 <= textlen; i += 32) {
+        __m256i b0 = _mm256_loadu_si256((const __m256i *)(text + i));
+        __m256i b1 = _mm256_loadu_si256((const __m256i *)(text + i + patlen - 1));
+        __m256i eq = _mm256_and_si256(_mm256_cmpeq_epi8(b0, first), _mm256_cmpeq_epi8(b1, last));
+        unsigned int mask = (unsigned int)_mm256_movemask_epi8(eq);
+        if (mask) {
+            const byte *p = check_mask(text, i, mask, pat, patlen);
+            if (p) {
+                return p;
+            }
+        }
+    }
+    return search_tail(text, textlen, pat, patlen, i);
+}
+
+static bool cpu_has_avx2() {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return false;
+    }
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 6) != 6) {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+
+static SearchKernel best_kernel() {
+    return cpu_has_avx2() ? KERNEL_AVX2 : KERNEL_SSE2;
+}
+
+#else
+
+// No x86 SIMD. These exist so callers link but are never selected
+const byte *search_sse2(const byte *text, size_t textlen, const byte *pat, size_t patlen) {
+    if (patlen < 2) {
+        return patlen ? (const byte *)memchr(text, pat[0], textlen) : text;
+    }
+    return search_tail(text, textlen, pat, patlen, 0);
+}
+
+const byte *search_avx2(const byte *text, size_t textlen, const byte *pat, size_t patlen) {
+    return search_sse2(text, textlen, pat, patlen);
+}
+
+static SearchKernel best_kernel() {
+    return KERNEL_SCALAR;
+}
+
+#endif
+
+static SearchKernel _kernel = best_kernel();
+
+void set_search_kernel(SearchKernel kernel) {
+    SearchKernel best = best_kernel();
+    if (kernel == KERNEL_AUTO || kernel > best) {
+        _kernel = best;
+    } else {
+        _kernel = kernel;
+    }
+}
+
+SearchKernel get_search_kernel() {
+    return _kernel;
+}
+
+simd_search_t get_simd_search(size_t patlen) {
+    if (patlen > SIMD_MAX_PATLEN) {
+        return NULL;
+    }
+    switch (_kernel) {
+    case KERNEL_AVX2:
+        return search_avx2;
+    case KERNEL_SSE2:
+        return search_sse2;
+    default:
+        return NULL;
+    }
+}
@@ -0,0 +1,33 @@
+#ifndef SEARCH_SIMD_H
+#define SEARCH_SIMD_H
+
+#include <stddef.h>
+#include "BinString.h"
+
+// Search kernels that can be used instead of Boyer-Moore scan_text()
+enum SearchKernel {
+    KERNEL_AUTO,        // best kernel the CPU supports
+    KERNEL_BOYER_MOORE, // Boyer-Moore scan_text() for every pattern length
+    KERNEL_SCALAR,      // scan_text() or a kernel for the pattern length, see boyer_moore.cpp
+    KERNEL_SSE2,
+    KERNEL_AVX2
+};
+
+// Select the kernel used by boyer_moore() and boyer_moore_all().
+// A kernel the CPU does not support falls back to the best one it does.
+void set_search_kernel(SearchKernel kernel);
+
+// The kernel that is actually used
+SearchKernel get_search_kernel();
+
+// Return first occurrence of pat in text or NULL
+typedef const byte *(*simd_search_t)(const byte *text, size_t textlen, const byte *pat, size_t patlen);
+
+// The SIMD search to use for a pattern of length patlen, or NULL if
+//  Boyer-Moore should be used
+simd_search_t get_simd_search(size_t patlen);
+
+const byte *search_sse2(const byte *text, size_t textlen, const byte *pat, size_t patlen);
+const byte *search_avx2(const byte *text, size_t textlen, const byte *pat, size_t patlen);
+
+#endif